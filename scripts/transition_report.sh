@@ -0,0 +1,29 @@
+#!/bin/sh
+# Side-by-side clause counts and solve times of the direct and compact
+# transition encodings of solve_base, on the first trial that reaches the
+# CNF for each size and seed ("-" when none does within the timeout: the
+# greedy clique needs more queries at large sizes).
+# usage: scripts/transition_report.sh [main binary] [num_queries] [seeds] [timeout] [sizes]
+MAIN=${1:-build/release/main}
+QUERIES=${2:-3}
+SEEDS=${3:-1}
+TIMEOUT=${4:-300}
+SIZES=${5:-"12 18 24 30 36 42 48 54 60 66 72 78 84 90"}
+
+printf "%-5s %-5s %-8s %10s %12s %9s %9s\n" size seed encoding vars clauses cnf_s solve_s
+for size in $SIZES; do
+  for seed in $(echo "$SEEDS" | tr ',' ' '); do
+    for enc in direct compact; do
+      OUT=$(OMP_NUM_THREADS=1 timeout "$TIMEOUT" "$MAIN" "$size" 1 "$QUERIES" 1.0 0 \
+              seed="$seed" verbose=1 transitions="$enc" 2>&1)
+      CNF=$(echo "$OUT" | grep -m1 '"solve_base cnf"' | sed 's/.*= {//; s/}//')
+      SOLVE=$(echo "$OUT" | grep -m1 '"solve_base solve"' | sed 's/.*= {//; s/}//')
+      VARS=$(echo "$CNF" | cut -d, -f2)
+      CLAUSES=$(echo "$CNF" | cut -d, -f3)
+      CNF_T=$(echo "$CNF" | cut -d, -f4)
+      SOLVE_T=$(echo "$SOLVE" | cut -d, -f3)
+      printf "%-5s %-5s %-8s %10s %12s %9s %9s\n" "$size" "$seed" "$enc" \
+        "${VARS:--}" "${CLAUSES:--}" "${CNF_T:--}" "${SOLVE_T:-timeout}"
+    done
+  done
+done
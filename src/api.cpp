@@ -1,32 +1,124 @@
 #include "api.hpp"
+#include "trace.hpp"
+#include "record.hpp"
 #include "httplib.h"
 #include <nlohmann/json.hpp>
 using namespace nlohmann;
 
-unique_ptr<httplib::SSLClient> client = nullptr;
+string server_url = "https://31pwr5t6ij.execute-api.eu-west-2.amazonaws.com";
+unique_ptr<httplib::Client> client = nullptr;
+api_retry_config retry_config;
+
+void api_set_server(string const& url) {
+  server_url = url;
+  client = nullptr;
+}
+
+void api_set_retry(api_retry_config const& config) {
+  retry_config = config;
+}
+
 void make_client(){
   if(!client) {
-    client = make_unique<httplib::SSLClient>
-      ("31pwr5t6ij.execute-api.eu-west-2.amazonaws.com", 443);
-    client->set_connection_timeout(0, 3000000); // 300 milliseconds
-    client->set_read_timeout(15, 0); // 5 seconds
-    client->set_write_timeout(15, 0); // 5 seconds
+    client = make_unique<httplib::Client>(server_url);
+    client->set_keep_alive(true);
+    client->set_connection_timeout(3, 0); // 3 seconds
+    client->set_read_timeout(15, 0); // 15 seconds
+    client->set_write_timeout(15, 0); // 15 seconds
   }
 }
 
-void check_response(httplib::Result& response) {
-  if(!response) {
-    cerr << "Unexpected server response:\nNo response from server" << endl;
-    exit(1);
+// Latency histograms per endpoint, in power-of-two buckets of milliseconds.
+struct latency_hist {
+  array<i64, 20> count = {};
+  i64 total = 0, failures = 0;
+  f64 sum_ms = 0, max_ms = 0;
+
+  void add(f64 ms) {
+    int b = 0;
+    while(b+1 < (int)count.size() && (1<<b) <= ms) b += 1;
+    count[b] += 1;
+    total += 1;
+    sum_ms += ms;
+    max_ms = max(max_ms, ms);
   }
+};
+
+mutex stats_mutex;
+map<string, latency_hist> latency;
 
-  if(response->status != 200 && response->status != 201) {
-    cerr << "Unexpected server response:\nHTTP code: " << response->status
-         << "\nResponse body: " << response->body << endl;
-    exit(2);
+void record_latency(string const& url, f64 ms, bool ok) {
+  lock_guard<mutex> lock(stats_mutex);
+  auto& h = latency[url];
+  if(ok) h.add(ms);
+  else h.failures += 1;
+}
+
+void api_print_stats() {
+  lock_guard<mutex> lock(stats_mutex);
+  for(auto const& [url, h] : latency) {
+    cerr << url << ": " << h.total << " ok, " << h.failures << " failed";
+    if(h.total) cerr << ", mean " << h.sum_ms / h.total << "ms, max " << h.max_ms << "ms";
+    cerr << "\n ";
+    FOR(b, h.count.size()) if(h.count[b]) {
+      cerr << " <" << (1<<b) << "ms:" << h.count[b];
+    }
+    cerr << endl;
   }
 }
 
+bool transient(int status) {
+  return status == 429 || status >= 500;
+}
+
+// POST with retries. A lost response may still have been processed by the
+// server: it is only retried when resending is harmless (select resets
+// the problem again, explore answers on the same map); a guess is only
+// resent when the server answered with an error status.
+string post(string const& url, string const& body, bool idempotent) {
+  make_client();
+  int delay_ms = retry_config.initial_delay_ms;
+  FOR(attempt, retry_config.max_attempts) {
+    if(attempt > 0) {
+      // full jitter; explores also run on the pipeline thread
+      static thread_local RNG R(chrono::steady_clock::now().time_since_epoch().count());
+      int d = R.random32(delay_ms + 1);
+      this_thread::sleep_for(chrono::milliseconds(d));
+      delay_ms = min(2 * delay_ms, retry_config.max_delay_ms);
+    }
+    timer T;
+    auto response = client->Post(url, body, "application/json");
+    f64 ms = 1000 * T.elapsed();
+    if(!response) {
+      record_latency(url, ms, false);
+      cerr << url << ": no response (" << httplib::to_string(response.error()) << ")" << endl;
+      // drop the connection, it may be in a bad state
+      client = nullptr;
+      make_client();
+      if(!idempotent) throw api_error(url + ": no response");
+      continue;
+    }
+    if(response->status == 200 || response->status == 201) {
+      record_latency(url, ms, true);
+      return move(response->body);
+    }
+    record_latency(url, ms, false);
+    cerr << url << ": HTTP " << response->status << ": " << response->body << endl;
+    if(!transient(response->status)) {
+      throw api_error(url + ": HTTP " + to_string(response->status) + ": " + response->body);
+    }
+  }
+  throw api_error(url + ": giving up after " + to_string(retry_config.max_attempts) + " attempts");
+}
+
+void api_warm_up() {
+  make_client();
+  // any answer will do, it opens the keep-alive connection (and TLS session)
+  timer T;
+  auto response = client->Get("/");
+  record_latency("warm-up", 1000 * T.elapsed(), (bool)response);
+}
+
 string get_problem_name(int size, int num_dups) {
   if(num_dups == 1) {
     if(size == 3) return "probatio";
@@ -53,6 +145,18 @@ string get_problem_name(int size, int num_dups) {
   impossible();
 }
 
+bool find_problem(string const& name, int& size, int& num_dups) {
+  FORU(d, 1, 3) for(int s : {3, 6, 12, 18, 24, 30}) {
+    if(s == 3 && d > 1) continue;
+    if(get_problem_name(s, d) == name) {
+      size = s;
+      num_dups = d;
+      return true;
+    }
+  }
+  return false;
+}
+
 string cached_id;
 string get_id() {
   if(cached_id.empty()) {
@@ -62,74 +166,153 @@ string get_id() {
   return cached_id;
 }
 
+// Request bodies are written straight into a per-thread buffer, and the
+// explore results are read with a SAX parser into the answer arrays,
+// without building a json DOM on either side.
+
+void append_string(string& out, string const& v) {
+  out += '"';
+  for(char c : v) {
+    if(c == '"' || c == '\\') out += '\\';
+    out += c;
+  }
+  out += '"';
+}
+
+void append_int(string& out, int v) {
+  char tmp[16];
+  auto r = to_chars(tmp, tmp + sizeof(tmp), v);
+  out.append(tmp, r.ptr);
+}
+
+// {"results": [[int, ...], ...], ...}: everything else is skipped
+struct results_sax : json_sax<json> {
+  vector<vector<int>>& out;
+  int depth = 0;
+  int results_depth = -1; // depth of the results array, when inside it
+  bool next_is_results = false;
+
+  results_sax(vector<vector<int>>& out_) : out(out_) { }
+
+  bool value(i64 v) {
+    next_is_results = false;
+    if(results_depth != -1 && depth == results_depth + 1) out.back().pb(v);
+    return true;
+  }
+
+  bool null() override { return true; }
+  bool boolean(bool) override { return true; }
+  bool number_integer(number_integer_t v) override { return value(v); }
+  bool number_unsigned(number_unsigned_t v) override { return value(v); }
+  bool number_float(number_float_t, string_t const&) override { return true; }
+  bool string(string_t&) override { next_is_results = false; return true; }
+  bool binary(binary_t&) override { return true; }
+
+  bool key(string_t& k) override {
+    next_is_results = depth == 1 && k == "results";
+    return true;
+  }
+
+  bool start_object(size_t) override {
+    next_is_results = false;
+    depth += 1;
+    return true;
+  }
+  bool end_object() override { depth -= 1; return true; }
+
+  bool start_array(size_t) override {
+    depth += 1;
+    if(next_is_results) results_depth = depth;
+    else if(results_depth != -1 && depth == results_depth + 1) out.eb();
+    next_is_results = false;
+    return true;
+  }
+  bool end_array() override {
+    if(depth == results_depth) results_depth = -1;
+    depth -= 1;
+    return true;
+  }
+
+  bool parse_error(size_t, std::string const&, detail::exception const& e) override {
+    throw api_error(std::string("bad explore response: ") + e.what());
+  }
+};
+
 void api_select(string const& problem) {
-  make_client();
+  trace_scope scope("api_select");
 
   string url = "/select";
 
-  json j;
-  j["id"] = get_id();
-  j["problemName"] = problem;
-  auto str = j.dump();
+  thread_local string str;
+  str.clear();
+  str += "{\"id\":"; append_string(str, get_id());
+  str += ",\"problemName\":"; append_string(str, problem);
+  str += "}";
 
-  auto response = client->Post(url.c_str(), str.c_str(), "application/json");
-  check_response(response);
+  post(url, str, true);
+  record_select(problem);
 }
 
 vector<vector<int>> api_explore(vector<string> const& data) {
-  make_client();
+  trace_scope scope("api_explore");
 
   string url = "/explore";
 
-  json j;
-  j["id"] = get_id();
-  for(string s : data) j["plans"].emplace_back(s);
-  auto str = j.dump();
+  thread_local string str;
+  str.clear();
+  str += "{\"id\":"; append_string(str, get_id());
+  str += ",\"plans\":[";
+  FOR(i, data.size()) {
+    if(i) str += ',';
+    append_string(str, data[i]);
+  }
+  str += "]}";
 
-  auto response = client->Post(url.c_str(), str.c_str(), "application/json");
-  check_response(response);
-  istringstream is(response->body);
-  json r; is >> r;
+  auto body = post(url, str, true);
   vector<vector<int>> x;
-  for(json const& w : r["results"]) {
-    x.eb();
-    for(json const& v : w) x.back().eb(v.get<int>());
-  }
+  x.reserve(data.size());
+  results_sax sax(x);
+  json::sax_parse(body, &sax);
+  if(x.size() != data.size()) throw api_error("explore: " + to_string(x.size()) + " results");
+  record_explore(data, x);
   return x;
 }
 
 bool api_guess(layout const& L) {
-  make_client();
+  trace_scope scope("api_guess");
 
   string url = "/guess";
 
-  json j;
-  j["id"] = get_id();
-  FOR(i, L.size*L.num_dups) j["map"]["rooms"].emplace_back(L.tag[i]);
-  j["map"]["startingRoom"] = L.start;
+  thread_local string str;
+  str.clear();
+  str += "{\"id\":"; append_string(str, get_id());
+  str += ",\"map\":{\"rooms\":[";
+  FOR(i, L.size*L.num_dups) {
+    if(i) str += ',';
+    append_int(str, L.tag[i]);
+  }
+  str += "],\"startingRoom\":"; append_int(str, L.start);
+  str += ",\"connections\":[";
   auto doors = L.get_doors();
-  // debug(doors);
+  bool first = true;
   for(auto [a,b,c,d] : doors) {
-    json v;
-    v["from"]["room"] = a;
-    v["from"]["door"] = b;
-    v["to"]["room"] = c;
-    v["to"]["door"] = d;
-    j["map"]["connections"].emplace_back(v);
-  }
-  
-  auto str = j.dump();
-
-  // debug(str);
-
-  auto response = client->Post(url.c_str(), str.c_str(), "application/json");
-  if(!response || (response->status != 200 && response->status != 201)) {
-    // TODO: handle
-    return false;
-  }
-  // check_response(response);
-  debug(response->body);
-  istringstream is(response->body);
-  json r; is >> r;
-  return r["correct"].get<bool>();
+    if(!first) str += ',';
+    first = false;
+    str += "{\"from\":{\"room\":"; append_int(str, a);
+    str += ",\"door\":"; append_int(str, b);
+    str += "},\"to\":{\"room\":"; append_int(str, c);
+    str += ",\"door\":"; append_int(str, d);
+    str += "}}";
+  }
+  str += "]}}";
+
+  auto body = post(url, str, false);
+  debug(body);
+  json r = json::parse(body, nullptr, false);
+  if(r.is_discarded() || !r.contains("correct") || !r["correct"].is_boolean()) {
+    throw api_error("guess: bad response " + body);
+  }
+  bool correct = r["correct"].get<bool>();
+  record_guess(L, correct);
+  return correct;
 }
@@ -2,7 +2,31 @@
 
 #include "layout.hpp"
 
+// Thrown when a call fails for good: after the retries, on a non-transient
+// HTTP error, or on a lost guess (which cannot be resent safely).
+struct api_error : runtime_error {
+  using runtime_error::runtime_error;
+};
+
+// retries=, backoff_ms=, backoff_max_ms= in main
+struct api_retry_config {
+  int max_attempts = 8;
+  int initial_delay_ms = 200; // doubled after every attempt
+  int max_delay_ms = 10000;
+};
+
+// scheme://host[:port] of the contest server, e.g. a local mock_server
+void api_set_server(string const& url);
+void api_set_retry(api_retry_config const& config);
+
+// opens the keep-alive connection ahead of the first call
+void api_warm_up();
+// per-endpoint latency histograms, to stderr
+void api_print_stats();
+
 string get_problem_name(int size, int num_dups);
+// inverse of get_problem_name
+bool find_problem(string const& name, int& size, int& num_dups);
 void api_select(string const& problem);
 vector<vector<int>> api_explore(vector<string> const& data);
 bool api_guess(layout const& L);
@@ -0,0 +1,285 @@
+#include "header.hpp"
+#include "solver.hpp"
+#include "trace.hpp"
+#include <nlohmann/json.hpp>
+#include <sys/resource.h>
+using namespace nlohmann;
+
+// Deterministic sweep over (size, num_dups, num_queries, ratio, strategy)
+// with one simulated attempt per seed, reporting per-stage times, formula
+// sizes, and solved instances per CPU second.
+//
+//   bench sizes=12,30 dups=1,2 queries=6 ratios=0.5 strategies=staged,joint
+//         seeds=5 json=bench.json csv=bench.csv baseline=old.json tolerance=0.2
+//
+// Solver options (transitions=, amo=, ...) and trace= are passed through. With
+// baseline=, every configuration is compared against the stored run and
+// the exit code is 1 if one of them regressed. With wrong_base=1 (staged
+// only), every case also times solve_dup over another base layout, found
+// by solve_base with the one of the result excluded: mostly UNSAT proofs,
+// as in check_unique.
+
+// Peak RSS of the current case: the high-water mark of the process
+// (VmHWM) is reset before every case through clear_refs, down to the
+// memory still resident then (heap kept from the earlier cases
+// included). Where that is not possible, the peak is the one of the whole
+// process so far, as reported in the json ("rss_per_case").
+bool reset_peak_rss() {
+  ofstream out("/proc/self/clear_refs");
+  out << "5";
+  out.close();
+  return !out.fail();
+}
+
+i64 peak_rss_kb() {
+  ifstream in("/proc/self/status");
+  string line;
+  while(getline(in, line)) {
+    if(line.rfind("VmHWM:", 0) == 0) return stoll(line.substr(6));
+  }
+  rusage u;
+  getrusage(RUSAGE_SELF, &u);
+  return u.ru_maxrss;
+}
+
+// user + system time of the process, all threads
+f64 cpu_seconds() {
+  rusage u;
+  getrusage(RUSAGE_SELF, &u);
+  auto sec = [](timeval t) { return t.tv_sec + 1e-6 * t.tv_usec; };
+  return sec(u.ru_utime) + sec(u.ru_stime);
+}
+
+struct bench_case {
+  int size, num_dups, num_queries;
+  f32 ratio;
+  string strategy;
+  u64 seed;
+  bool success = false;
+  f64 t_queries = 0, t_verify = 0, t_total = 0, t_cpu = 0;
+  solve_stats stats;
+  i64 rss_kb = 0;
+  bool rss_per_case = false;
+  // solve_dup over another base (wrong_base=1): solve time, and result
+  // (-1 if there was no other base)
+  f64 t_wrong_dup = 0;
+  int wrong_dup_result = -1;
+};
+
+bench_case run_case(int size, int num_dups, int num_queries, f32 ratio,
+                    string const& strategy, u64 seed, solve_options opt, bool wrong_base)
+{
+  bench_case c;
+  c.size = size; c.num_dups = num_dups; c.num_queries = num_queries;
+  c.ratio = ratio; c.strategy = strategy; c.seed = seed;
+  opt.sat.seed = seed;
+  opt.strategy = parse_solve_strategy(strategy);
+  opt.stats = &c.stats;
+  RNG R(seed);
+  c.rss_per_case = reset_peak_rss();
+  timer total;
+  f64 cpu = cpu_seconds();
+
+  layout L; L.generate(size, num_dups, R);
+  layout_queries Q(L);
+  timer T;
+  auto QS = make_queries(Q, size, num_dups, num_queries, ratio, R, opt.design);
+  c.t_queries = T.elapsed();
+
+  layout R1;
+  auto R2 = solve_layout(QS, size, num_dups, num_queries, R, opt, &R1);
+  if(R2.size != 0) {
+    T.reset();
+    c.success = test_equivalence(L, R2);
+    c.t_verify = T.elapsed();
+  }
+
+  if(wrong_base && R1.size != 0 && opt.strategy == solve_strategy::staged) {
+    solve_stats stats;
+    vector<layout> exclude = { R1 };
+    solve_options o = opt;
+    o.stats = &stats;
+    o.exclude = &exclude;
+    auto B = solve_base(QS, size, num_dups, num_queries, R, o);
+    if(B.size != 0) {
+      o.exclude = nullptr;
+      solve_dup(QS, size, num_dups, num_queries, B, o);
+      c.t_wrong_dup = stats.t_dup_solve;
+      c.wrong_dup_result = stats.dup_result;
+    }
+  }
+
+  c.t_total = total.elapsed();
+  c.t_cpu = cpu_seconds() - cpu;
+  c.rss_kb = peak_rss_kb();
+  return c;
+}
+
+json case_json(bench_case const& c) {
+  auto const& s = c.stats;
+  return json {
+    {"size", c.size}, {"num_dups", c.num_dups}, {"num_queries", c.num_queries},
+    {"ratio", c.ratio}, {"strategy", c.strategy}, {"seed", c.seed},
+    {"success", c.success},
+    {"t_queries", c.t_queries}, {"t_trie", s.t_trie}, {"t_clique", s.t_clique},
+    {"t_quotient", s.t_quotient}, {"t_reduce", s.t_reduce}, {"t_cnf", s.t_cnf},
+    {"t_solve", s.t_solve}, {"t_dup", s.t_dup_cnf + s.t_dup_solve},
+    {"t_dup_cnf", s.t_dup_cnf}, {"t_dup_solve", s.t_dup_solve}, {"t_joint", s.t_joint},
+    {"t_verify", c.t_verify},
+    {"t_total", c.t_total}, {"t_cpu", c.t_cpu},
+    {"base_vars", s.base_vars}, {"base_clauses", s.base_clauses},
+    {"dup_vars", s.dup_vars}, {"dup_clauses", s.dup_clauses},
+    {"joint_vars", s.joint_vars}, {"joint_clauses", s.joint_clauses},
+    {"base_result", s.base_result}, {"dup_result", s.dup_result},
+    {"joint_result", s.joint_result},
+    {"rss_kb", c.rss_kb}, {"rss_per_case", c.rss_per_case},
+    {"t_wrong_dup", c.t_wrong_dup}, {"wrong_dup_result", c.wrong_dup_result},
+  };
+}
+
+string config_key(json const& c) {
+  ostringstream ss;
+  ss << c["size"].get<int>() << "x" << c["num_dups"].get<int>()
+     << " q" << c["num_queries"].get<int>() << " r" << c["ratio"].get<f64>();
+  // keys of staged runs stay those of older baselines
+  if(c.contains("strategy") && c["strategy"] != "staged") {
+    ss << " " << c["strategy"].get<string>();
+  }
+  return ss.str();
+}
+
+f64 median(vector<f64> v) {
+  if(v.empty()) return 0;
+  sort(all(v));
+  return v[v.size()/2];
+}
+
+// one entry per configuration, over its seeds
+json summarize(json const& cases) {
+  map<string, vector<json>> by_key;
+  vector<string> keys;
+  for(auto const& c : cases) {
+    auto key = config_key(c);
+    if(!by_key.count(key)) keys.pb(key);
+    by_key[key].pb(c);
+  }
+  json out = json::array();
+  for(auto const& key : keys) {
+    auto const& v = by_key[key];
+    int num_success = 0;
+    f64 cpu = 0;
+    vector<f64> total, solve, dup, dup_cnf, clauses, wrong_unsat;
+    for(auto const& c : v) {
+      num_success += c["success"].get<bool>();
+      cpu += c["t_cpu"].get<f64>();
+      total.pb(c["t_total"].get<f64>());
+      solve.pb(c["t_solve"].get<f64>());
+      dup.pb(c["t_dup"].get<f64>());
+      dup_cnf.pb(c["t_dup_cnf"].get<f64>());
+      clauses.pb(c["base_clauses"].get<f64>());
+      if(c["wrong_dup_result"].get<int>() == 20) wrong_unsat.pb(c["t_wrong_dup"].get<f64>());
+    }
+    out.pb(json {
+      {"key", key}, {"runs", v.size()},
+      {"success_rate", 1.0 * num_success / v.size()},
+      {"median_t_total", median(total)},
+      {"median_t_solve", median(solve)},
+      {"median_t_dup", median(dup)},
+      {"median_t_dup_cnf", median(dup_cnf)},
+      {"median_base_clauses", median(clauses)},
+      {"wrong_unsat", wrong_unsat.size()},
+      {"median_t_wrong_unsat", median(wrong_unsat)},
+      {"success_per_cpu_s", cpu > 0 ? num_success / cpu : 0},
+    });
+  }
+  return out;
+}
+
+// true if some configuration regressed against the baseline
+bool compare(json const& baseline, json const& current, f64 tolerance) {
+  map<string, json> base;
+  for(auto const& s : baseline["summary"]) base[s["key"].get<string>()] = s;
+  bool regressed = false;
+  for(auto const& s : current["summary"]) {
+    auto key = s["key"].get<string>();
+    if(!base.count(key)) {
+      cerr << key << ": not in baseline" << endl;
+      continue;
+    }
+    auto const& b = base[key];
+    f64 t0 = b["median_t_total"].get<f64>(), t1 = s["median_t_total"].get<f64>();
+    f64 r0 = b["success_rate"].get<f64>(), r1 = s["success_rate"].get<f64>();
+    // sub-10ms medians are noise
+    bool slower = t1 > max(t0 * (1 + tolerance), t0 + 0.01);
+    bool worse = r1 < r0 - 1e-9;
+    regressed |= slower || worse;
+    cerr << key << ": time " << t0 << " -> " << t1
+         << ", success " << r0 << " -> " << r1
+         << (slower || worse ? "  REGRESSION" : "") << endl;
+  }
+  return regressed;
+}
+
+void write_csv(string const& path, json const& cases) {
+  ofstream out(path);
+  runtime_assert(out.good());
+  vector<string> cols;
+  for(auto const& [k, v] : cases[0].items()) cols.pb(k);
+  FOR(i, cols.size()) out << (i ? "," : "") << cols[i];
+  out << "\n";
+  for(auto const& c : cases) {
+    FOR(i, cols.size()) out << (i ? "," : "") << c[cols[i]].dump();
+    out << "\n";
+  }
+}
+
+int main(int argc, char** argv) {
+  options opts; opts.parse(argc, argv, 1);
+  auto opt = parse_solve_options(opts);
+  opt.verbose = false;
+  if(opts.has("trace")) trace_open(opts.get_string("trace", ""));
+
+  auto sizes = opts.get_list("sizes", "12,18,24,30");
+  auto dups = opts.get_list("dups", "1,2");
+  auto nqueries = opts.get_list("queries", "6");
+  auto ratios = opts.get_list("ratios", "0.5");
+  auto strategies = opts.get_list("strategies", "staged");
+  for(auto const& st : strategies) {
+    if(parse_solve_strategy(st) == solve_strategy::joint) check_joint_options(opts);
+  }
+  int num_seeds = opts.get_int("seeds", 5);
+  u64 first_seed = opts.get_int("first_seed", 1);
+  bool wrong_base = opts.get_int("wrong_base", 0);
+
+  json cases = json::array();
+  for(auto const& s : sizes) for(auto const& d : dups)
+  for(auto const& q : nqueries) for(auto const& r : ratios)
+  for(auto const& st : strategies) {
+    FOR(i, num_seeds) {
+      auto c = run_case(stoi(s), stoi(d), stoi(q), stof(r), st, first_seed + i, opt, wrong_base);
+      cases.pb(case_json(c));
+      cerr << config_key(cases.back()) << " seed " << c.seed << ": "
+           << (c.success ? "ok" : "FAIL") << " " << c.t_total << "s" << endl;
+    }
+  }
+
+  json result {
+    {"options", opts.values},
+    {"cases", cases},
+    {"summary", summarize(cases)},
+  };
+
+  auto json_path = opts.get_string("json", "bench.json");
+  ofstream(json_path) << result.dump(2) << endl;
+  if(opts.has("csv") && !cases.empty()) write_csv(opts.get_string("csv", ""), cases);
+
+  for(auto const& s : result["summary"]) cerr << s.dump() << endl;
+
+  if(opts.has("baseline")) {
+    ifstream in(opts.get_string("baseline", ""));
+    runtime_assert(in.good());
+    json baseline = json::parse(in);
+    if(compare(baseline, result, opts.get_f64("tolerance", 0.2))) return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,69 @@
+#include "cnf.hpp"
+
+amo_encoding parse_amo_encoding(string const& name) {
+  if(name == "pairwise") return amo_encoding::pairwise;
+  if(name == "sequential") return amo_encoding::sequential;
+  if(name == "commander") return amo_encoding::commander;
+  if(name == "product") return amo_encoding::product;
+  throw runtime_error("unknown at-most-one encoding: " + name);
+}
+
+void cnf_builder::at_most_one(vector<int> const& xs) {
+  if(xs.size() <= 4) return amo_pairwise(xs);
+  switch(amo) {
+  case amo_encoding::pairwise: return amo_pairwise(xs);
+  case amo_encoding::sequential: return amo_sequential(xs);
+  case amo_encoding::commander: return amo_commander(xs);
+  case amo_encoding::product: return amo_product(xs);
+  }
+  impossible();
+}
+
+void cnf_builder::amo_pairwise(vector<int> const& xs) {
+  FOR(j1, xs.size()) FOR(j2, j1) clause({-xs[j1], -xs[j2]});
+}
+
+// s[i] <=> one of xs[0..i] is true
+void cnf_builder::amo_sequential(vector<int> const& xs) {
+  int n = xs.size();
+  vector<int> s(n-1);
+  for(int& x : s) x = new_var();
+  clause({-xs[0], s[0]});
+  FORU(i, 1, n-2) {
+    clause({-xs[i], s[i]});
+    clause({-s[i-1], s[i]});
+    clause({-xs[i], -s[i-1]});
+  }
+  clause({-xs[n-1], -s[n-2]});
+}
+
+// one commander per group of 3, at most one commander overall
+void cnf_builder::amo_commander(vector<int> const& xs) {
+  vector<int> commanders;
+  for(size_t g = 0; g < xs.size(); g += 3) {
+    vector<int> group(xs.begin() + g, xs.begin() + min(g+3, xs.size()));
+    int c = new_var();
+    commanders.pb(c);
+    amo_pairwise(group);
+    for(int x : group) clause({-x, c});
+    group.pb(-c);
+    clause(group);
+  }
+  at_most_one(commanders);
+}
+
+// xs laid out on a p*q grid: a true literal implies its row and column
+void cnf_builder::amo_product(vector<int> const& xs) {
+  int n = xs.size();
+  int p = ceil(sqrt(n));
+  int q = (n+p-1) / p;
+  vector<int> rows(p), cols(q);
+  for(int& x : rows) x = new_var();
+  for(int& x : cols) x = new_var();
+  FOR(k, n) {
+    clause({-xs[k], rows[k/q]});
+    clause({-xs[k], cols[k%q]});
+  }
+  at_most_one(rows);
+  at_most_one(cols);
+}
@@ -0,0 +1,75 @@
+#pragma once
+
+#include "sat.hpp"
+
+enum struct amo_encoding {
+  pairwise,
+  sequential, // Sinz's sequential counter
+  commander,  // Klieber & Kwon, groups of 3
+  product,    // Chen's 2-product
+};
+
+amo_encoding parse_amo_encoding(string const& name);
+
+// Emits clauses into a sink (a solver or a clause_log) while counting
+// variables and clauses. Cardinality constraints use the selected
+// at-most-one encoding; groups of at most 4 literals are always pairwise.
+struct cnf_builder {
+  amo_encoding amo;
+  clause_sink* out;
+  int num_vars = 0;
+  i64 num_clauses = 0;
+
+  cnf_builder(amo_encoding amo_ = amo_encoding::pairwise, clause_sink* out_ = nullptr)
+    : amo(amo_), out(out_) { }
+
+  int new_var() { return ++num_vars; }
+
+  // Literal by literal, 0 to end the clause. A single kissat instance
+  // takes the literals as they come; other sinks get the whole clause in
+  // one (virtual) call.
+  FORCE_INLINE void add(int lit) {
+    if(lit == 0) num_clauses += 1;
+    if(kissat* s = out->direct) {
+      kissat_add(s, lit);
+    }else if(lit != 0) {
+      buf.pb(lit);
+    }else{
+      out->add_clause(buf.data(), buf.size());
+      buf.clear();
+    }
+  }
+
+  FORCE_INLINE void clause(int const* lits, int n) {
+    num_clauses += 1;
+    if(kissat* s = out->direct) {
+      FOR(i, n) kissat_add(s, lits[i]);
+      kissat_add(s, 0);
+    }else{
+      out->add_clause(lits, n);
+    }
+  }
+
+  FORCE_INLINE void clause(initializer_list<int> lits) {
+    clause(lits.begin(), lits.size());
+  }
+
+  void clause(vector<int> const& lits) {
+    clause(lits.data(), lits.size());
+  }
+
+  void at_least_one(vector<int> const& xs) { clause(xs); }
+  void at_most_one(vector<int> const& xs);
+  void exactly_one(vector<int> const& xs) {
+    at_least_one(xs);
+    at_most_one(xs);
+  }
+
+private:
+  vector<int> buf; // the clause being built by add
+
+  void amo_pairwise(vector<int> const& xs);
+  void amo_sequential(vector<int> const& xs);
+  void amo_commander(vector<int> const& xs);
+  void amo_product(vector<int> const& xs);
+};
@@ -0,0 +1,113 @@
+#include "designer.hpp"
+#include "trie.hpp"
+
+vector<plan_t> random_plans
+(int size, int num_dups, int num_queries, f32 ratio, RNG& R, bool blocks)
+{
+  const int query_size = num_dups == 1 ? 18 * size : 6 * size * num_dups;
+
+  vector<plan_t> queries(num_queries);
+  array<int, 6> perm = {0,1,2,3,4,5};
+  FOR(i, num_queries) FOR(j, query_size) {
+    int door;
+    if(blocks) {
+      if(j % 6 == 0) R.shuffle(perm.begin(), perm.end());
+      door = perm[j % 6];
+    }else{
+      door = R.random32(6);
+    }
+    queries[i].pb({door, -1});
+    if(1.0*(i*query_size+j)/query_size/num_queries > ratio) {
+      queries[i].back()[1] = R.random32(4);
+    }
+  }
+  return queries;
+}
+
+// higher is better
+static f64 score_plans
+(vector<plan_t> const& plans, layout const& L, RNG& R)
+{
+  int size = L.size, n = L.size * L.num_dups;
+  replay_engine E(L);
+  auto answers = E.evaluate(0, plans);
+
+  obs_trie T;
+  T.build(plans, answers);
+  bool clique_ok = (int)max_clique(T, R).size() >= size;
+
+  // coverage, and rooms seen again after being marked (what tells the
+  // copies apart in solve_dup)
+  vector<char> base_seen(6*size), seen(6*n), marked(n), revisited(n);
+  for(auto const& q : plans) {
+    int x = L.start;
+    bool prefix = true;
+    fill(all(marked), 0);
+    for(auto [k, t] : q) {
+      if(prefix) base_seen[6*(x%size)+k] = 1;
+      seen[6*x+k] = 1;
+      x = L.graph[x][k];
+      if(marked[x]) revisited[x] = 1;
+      if(t != -1) {
+        prefix = false;
+        marked[x] = 1;
+      }
+    }
+  }
+  f64 base_cov = 1.0 * count(all(base_seen), 1) / (6*size);
+  f64 cov = 1.0 * count(all(seen), 1) / (6*n);
+  f64 sep = L.num_dups == 1 ? 0 : 1.0 * count(all(revisited), 1) / n;
+  return 2 * clique_ok + base_cov + cov + sep;
+}
+
+vector<plan_t> design_plans
+(int size, int num_dups, int num_queries, f32 ratio, RNG& R, design_options const& opt)
+{
+  if(opt.candidates <= 0) return random_plans(size, num_dups, num_queries, ratio, R);
+
+  // the same sampled layouts for all the candidates
+  vector<layout> samples(opt.samples);
+  for(auto& L : samples) L.generate(size, num_dups, R);
+
+  const f32 shifts[] = { 0, -0.1, 0.1 };
+  vector<plan_t> best;
+  f64 best_score = -1;
+  FOR(c, opt.candidates) {
+    f32 r = clamp(ratio + shifts[c % 3], 0.0f, 1.0f);
+    auto plans = random_plans(size, num_dups, num_queries, r, R, c / 3 % 2);
+    f64 score = 0;
+    for(auto const& L : samples) score += score_plans(plans, L, R);
+    if(score > best_score) {
+      best_score = score;
+      best = move(plans);
+    }
+  }
+  return best;
+}
+
+vector<plan_t> separating_plans
+(layout const& a, layout const& b, int count, int tries, RNG& R)
+{
+  runtime_assert(a.size == b.size && a.num_dups == b.num_dups);
+  replay_engine E;
+  E.add(a);
+  E.add(b);
+
+  const int batch = replay_engine::W;
+  vector<plan_t> out;
+  for(int t = 0; t < tries && (int)out.size() < count; t += batch) {
+    vector<plan_t> plans;
+    FOR(i, batch) {
+      plans.pb(random_plans(a.size, a.num_dups, 1, R.randomDouble(), R, i % 2)[0]);
+    }
+    vector<int> which(batch, 0);
+    which.resize(2*batch, 1);
+    auto both = plans;
+    both.insert(both.end(), all(plans));
+    auto answers = E.evaluate(which, both);
+    FOR(i, batch) if(answers[i] != answers[batch+i] && (int)out.size() < count) {
+      out.pb(plans[i]);
+    }
+  }
+  return out;
+}
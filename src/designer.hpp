@@ -0,0 +1,35 @@
+#pragma once
+
+#include "layout.hpp"
+#include "replay.hpp"
+
+struct design_options {
+  int candidates = 8; // random plan sets to choose from; 0 for a single one
+  int samples = 4;    // simulated layouts scoring each candidate
+};
+
+// Random walks of the length used by make_queries. The doors are uniform,
+// or with blocks drawn as shuffled runs of the 6 doors so that every door
+// is used evenly; the steps after the first ratio of the whole set write
+// random labels.
+vector<plan_t> random_plans
+(int size, int num_dups, int num_queries, f32 ratio, RNG& R, bool blocks = false);
+
+// Best of N random plan sets: candidates drawn by random_plans (varying
+// the door generator and the position of the first write around ratio),
+// scored on layouts sampled with layout::generate by whether the
+// write-free prefixes yield a clique of size rooms (what solve_base
+// needs) and the coverage of the (room, door) pairs they reach. The doors
+// and the written labels are still random: walks steered towards the
+// pairs left unused on the samples solved less often than random ones,
+// the samples telling nothing of the hidden layout.
+vector<plan_t> design_plans
+(int size, int num_dups, int num_queries, f32 ratio, RNG& R, design_options const& opt);
+
+// Plans answered differently on the layouts a and b (of the same size),
+// for telling two models of the observations apart: random walks as in
+// random_plans, with the first write at various positions, replayed on
+// both. At most count of them, out of tries walks; empty if none of the
+// walks separates the layouts.
+vector<plan_t> separating_plans
+(layout const& a, layout const& b, int count, int tries, RNG& R);
@@ -275,7 +275,9 @@ struct RNG {
   inline T sample(vector<T> const& v) {
     return v[sample_index(v)];
   }
-} rng;
+};
+
+inline RNG rng;
 
 // Timer
 
@@ -1,5 +1,8 @@
     #pragma once
 
+// (door, charcoal label or -1) per step
+using plan_t = vector<array<int,2>>;
+
 struct layout {
   int size = 0;
   int num_dups = 0;
@@ -7,7 +10,7 @@ struct layout {
   vector<array<int, 6>> graph;
   int start;
 
-  void generate(int size_, int num_dups_) {
+  void generate(int size_, int num_dups_, RNG& R = rng) {
     size = size_;
     num_dups = num_dups_;
     tag.resize(size*num_dups);
@@ -15,16 +18,16 @@ struct layout {
 
     vector<int> tag0(size);
     FOR(i, size) tag0[i] = i%4;
-    rng.shuffle(tag0);
+    R.shuffle(tag0);
     FOR(i, size*num_dups) tag[i] = tag0[i%size];
 
     vector<array<int, 2>> doors0;
     FOR(i, size) FOR(j, 6) doors0.pb({i,j});
-    rng.shuffle(doors0);
+    R.shuffle(doors0);
     while(!doors0.empty()) {
       auto [x,a] = doors0.back(); doors0.pop_back();
       auto [y,b] = doors0.back(); doors0.pop_back();
-      vector<int> P(num_dups); iota(all(P),0); rng.shuffle(P);
+      vector<int> P(num_dups); iota(all(P),0); R.shuffle(P);
       FOR(i, num_dups) {
         int x1 = x + i * size;
         int y1 = y + P[i] * size;
@@ -33,7 +36,7 @@ struct layout {
       }
     }
 
-    start = rng.random32(size*num_dups);
+    start = R.random32(size*num_dups);
   }
 
   vector<int> evaluate_query(vector<array<int,2>> const& q) const {
@@ -61,6 +64,37 @@ struct layout {
   }
 
 
+  // Rooms renumbered in BFS order from start, doors in order as the
+  // tie-break, so that isomorphic layouts have equal forms. Flattened as
+  // the number of reached rooms, then tag and 6 successors per room.
+  vector<int> canonical() const {
+    int n = size * num_dups;
+    vector<int> id(n, -1), order;
+    order.reserve(n);
+    id[start] = 0; order.pb(start);
+    vector<int> out;
+    out.reserve(1 + 7*n);
+    out.pb(0);
+    FOR(i, order.size()) {
+      int x = order[i];
+      out.pb(tag[x]);
+      FOR(k, 6) {
+        int y = graph[x][k];
+        if(id[y] == -1) { id[y] = order.size(); order.pb(y); }
+        out.pb(id[y]);
+      }
+    }
+    out[0] = order.size();
+    return out;
+  }
+
+  // stable across runs, unlike uint64_hash
+  u64 canonical_hash() const {
+    u64 h = 0;
+    for(int v : canonical()) h = uint64_hash::hash_int(h ^ (u64)v) + 0x9E3779B97f4A7C15;
+    return h;
+  }
+
   vector<array<int, 4>> get_doors() const {
     vector<array<int, 4>> out;
     map<array<int, 2>, vector<int>> S;
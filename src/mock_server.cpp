@@ -0,0 +1,216 @@
+#include "header.hpp"
+#include "api.hpp"
+#include "options.hpp"
+#include "solver.hpp"
+#include "httplib.h"
+#include <nlohmann/json.hpp>
+using namespace nlohmann;
+
+// Local stand-in for the contest server: /select, /explore and /guess on
+// generated layouts, plus /stats with the query accounting.
+//
+//   mock_server port=8080 seed=1 latency_ms=50 jitter_ms=20
+//               error_rate=0.05 timeout_rate=0.01 timeout_ms=20000
+//
+// error_rate answers 500 without touching the state, timeout_rate sleeps
+// timeout_ms before answering (longer than the client's read timeout).
+// Point the solver at it with server=http://localhost:8080.
+
+struct mock_config {
+  int latency_ms = 0;
+  int jitter_ms = 0;
+  f64 error_rate = 0;
+  f64 timeout_rate = 0;
+  int timeout_ms = 20000;
+};
+
+struct mock_state {
+  mutex m;
+  RNG R;
+  mock_config config;
+
+  string problem;
+  layout L;
+  bool selected = false;
+  i64 query_count = 0;
+
+  i64 num_requests = 0, num_errors = 0, num_selects = 0, num_explores = 0;
+  i64 num_plans = 0, num_guesses = 0, num_correct = 0;
+  i64 total_query_count = 0; // over all the guessed problems
+};
+
+// labels seen along a plan ("0[1]23"), with the charcoal writes echoed
+// like the contest server does
+vector<int> walk(layout const& L, string const& plan) {
+  auto tag = L.tag;
+  int x = L.start;
+  vector<int> out;
+  out.pb(tag[x]);
+  FOR(i, plan.size()) {
+    char c = plan[i];
+    if(c == '[') {
+      runtime_assert(i+2 < (int)plan.size() && plan[i+2] == ']');
+      tag[x] = plan[i+1] - '0';
+      out.pb(tag[x]);
+      i += 2;
+    }else{
+      x = L.graph[x][c - '0'];
+      out.pb(tag[x]);
+    }
+  }
+  return out;
+}
+
+bool valid_plan(string const& plan) {
+  FOR(i, plan.size()) {
+    char c = plan[i];
+    if(c == '[') {
+      if(i+2 >= (int)plan.size() || plan[i+2] != ']') return false;
+      if(plan[i+1] < '0' || plan[i+1] > '3') return false;
+      i += 2;
+    }else if(c < '0' || c > '5') return false;
+  }
+  return true;
+}
+
+// the submitted map, in the same room numbering
+bool read_map(json const& j, layout& out, int size, int num_dups) {
+  int n = size * num_dups;
+  if(!j.contains("rooms") || (int)j["rooms"].size() != n) return false;
+  out.size = size;
+  out.num_dups = num_dups;
+  out.tag.resize(n);
+  FOR(i, n) out.tag[i] = j["rooms"][i].get<int>();
+  out.start = j["startingRoom"].get<int>();
+  if(out.start < 0 || out.start >= n) return false;
+  out.graph.assign(n, {-1,-1,-1,-1,-1,-1});
+  for(auto const& c : j["connections"]) {
+    int a = c["from"]["room"], b = c["from"]["door"];
+    int x = c["to"]["room"], y = c["to"]["door"];
+    if(a < 0 || a >= n || x < 0 || x >= n || b < 0 || b >= 6 || y < 0 || y >= 6) return false;
+    out.graph[a][b] = x;
+    out.graph[x][y] = a;
+  }
+  FOR(i, n) FOR(k, 6) if(out.graph[i][k] == -1) return false;
+  return true;
+}
+
+void reply(httplib::Response& res, int status, json const& j) {
+  res.status = status;
+  res.set_content(j.dump(), "application/json");
+}
+
+int main(int argc, char** argv) {
+  options opts; opts.parse(argc, argv, 1);
+  mock_state S;
+  S.R.reset(opts.get_int("seed", time(0)));
+  S.config.latency_ms = opts.get_int("latency_ms", 0);
+  S.config.jitter_ms = opts.get_int("jitter_ms", 0);
+  S.config.error_rate = opts.get_f64("error_rate", 0);
+  S.config.timeout_rate = opts.get_f64("timeout_rate", 0);
+  S.config.timeout_ms = opts.get_int("timeout_ms", 20000);
+  int port = opts.get_int("port", 8080);
+
+  // latency and fault injection, common to all the endpoints; false if
+  // the request must fail
+  auto inject = [&](httplib::Response& res) {
+    int delay;
+    bool fail, hang;
+    {
+      lock_guard<mutex> lock(S.m);
+      S.num_requests += 1;
+      delay = S.config.latency_ms;
+      if(S.config.jitter_ms > 0) delay += S.R.random32(S.config.jitter_ms + 1);
+      fail = S.R.randomDouble() < S.config.error_rate;
+      hang = S.R.randomDouble() < S.config.timeout_rate;
+      if(fail || hang) S.num_errors += 1;
+    }
+    if(hang) delay += S.config.timeout_ms;
+    if(delay > 0) this_thread::sleep_for(chrono::milliseconds(delay));
+    if(fail || hang) {
+      reply(res, 500, json {{"error", "injected failure"}});
+      return false;
+    }
+    return true;
+  };
+
+  httplib::Server server;
+
+  server.Post("/select", [&](httplib::Request const& req, httplib::Response& res) {
+    if(!inject(res)) return;
+    json j = json::parse(req.body, nullptr, false);
+    if(j.is_discarded() || !j.contains("problemName")) {
+      return reply(res, 400, json {{"error", "bad request"}});
+    }
+    string name = j["problemName"];
+    int size, num_dups;
+    if(!find_problem(name, size, num_dups)) {
+      return reply(res, 400, json {{"error", "unknown problem " + name}});
+    }
+    lock_guard<mutex> lock(S.m);
+    S.num_selects += 1;
+    S.problem = name;
+    S.L.generate(size, num_dups, S.R);
+    S.selected = true;
+    S.query_count = 0;
+    reply(res, 200, json {{"problemName", name}});
+  });
+
+  server.Post("/explore", [&](httplib::Request const& req, httplib::Response& res) {
+    if(!inject(res)) return;
+    json j = json::parse(req.body, nullptr, false);
+    if(j.is_discarded() || !j.contains("plans")) {
+      return reply(res, 400, json {{"error", "bad request"}});
+    }
+    vector<string> plans;
+    for(auto const& p : j["plans"]) plans.pb(p.get<string>());
+    for(auto const& p : plans) if(!valid_plan(p)) {
+      return reply(res, 400, json {{"error", "bad plan " + p}});
+    }
+    lock_guard<mutex> lock(S.m);
+    if(!S.selected) return reply(res, 400, json {{"error", "no problem selected"}});
+    json results = json::array();
+    for(auto const& p : plans) results.pb(walk(S.L, p));
+    // one query per plan, plus one for the request
+    S.query_count += plans.size() + 1;
+    S.num_explores += 1;
+    S.num_plans += plans.size();
+    reply(res, 200, json {{"results", results}, {"queryCount", S.query_count}});
+  });
+
+  server.Post("/guess", [&](httplib::Request const& req, httplib::Response& res) {
+    if(!inject(res)) return;
+    json j = json::parse(req.body, nullptr, false);
+    if(j.is_discarded() || !j.contains("map")) {
+      return reply(res, 400, json {{"error", "bad request"}});
+    }
+    lock_guard<mutex> lock(S.m);
+    if(!S.selected) return reply(res, 400, json {{"error", "no problem selected"}});
+    layout G;
+    bool correct = read_map(j["map"], G, S.L.size, S.L.num_dups)
+      && test_equivalence(S.L, G);
+    S.num_guesses += 1;
+    S.num_correct += correct;
+    S.total_query_count += S.query_count;
+    cerr << S.problem << ": " << (correct ? "correct" : "wrong")
+         << " after " << S.query_count << " queries" << endl;
+    // a guess ends the problem, like on the real server
+    S.selected = false;
+    reply(res, 200, json {{"correct", correct}});
+  });
+
+  server.Get("/stats", [&](httplib::Request const&, httplib::Response& res) {
+    lock_guard<mutex> lock(S.m);
+    reply(res, 200, json {
+        {"requests", S.num_requests}, {"errors", S.num_errors},
+        {"selects", S.num_selects}, {"explores", S.num_explores},
+        {"plans", S.num_plans}, {"guesses", S.num_guesses},
+        {"correct", S.num_correct}, {"queryCount", S.query_count},
+        {"totalQueryCount", S.total_query_count},
+      });
+  });
+
+  cerr << "listening on port " << port << endl;
+  runtime_assert(server.listen("0.0.0.0", port));
+  return 0;
+}
@@ -0,0 +1,43 @@
+#pragma once
+
+// Optional key=value arguments following the positional ones.
+struct options {
+  map<string, string> values;
+
+  void parse(int argc, char** argv, int from) {
+    FORU(i, from, argc-1) {
+      string arg = argv[i];
+      auto eq = arg.find('=');
+      runtime_assert(eq != string::npos);
+      values[arg.substr(0, eq)] = arg.substr(eq+1);
+    }
+  }
+
+  bool has(string const& key) const {
+    return values.count(key);
+  }
+
+  string get_string(string const& key, string const& def) const {
+    auto it = values.find(key);
+    return it == values.end() ? def : it->second;
+  }
+
+  i64 get_int(string const& key, i64 def) const {
+    auto it = values.find(key);
+    return it == values.end() ? def : stoll(it->second);
+  }
+
+  f64 get_f64(string const& key, f64 def) const {
+    auto it = values.find(key);
+    return it == values.end() ? def : stod(it->second);
+  }
+
+  // comma-separated values
+  vector<string> get_list(string const& key, string const& def) const {
+    vector<string> out;
+    stringstream ss(get_string(key, def));
+    string item;
+    while(getline(ss, item, ',')) if(!item.empty()) out.pb(item);
+    return out;
+  }
+};
@@ -0,0 +1,48 @@
+#include "queries.hpp"
+#include "api.hpp"
+
+string plan_to_string(plan_t const& q) {
+  string out;
+  for(auto [i,t] : q) {
+    out += ('0'+i);
+    if(t != -1) {
+      out += "[";
+      out += ('0'+t);
+      out += "]";
+    }
+  }
+  return out;
+}
+
+plan_t plan_from_string(string const& s) {
+  plan_t out;
+  FOR(i, s.size()) {
+    if(s[i] == '[') {
+      runtime_assert(!out.empty() && i+2 < (int)s.size());
+      out.back()[1] = s[i+1] - '0';
+      i += 2;
+    }else{
+      out.pb({s[i] - '0', -1});
+    }
+  }
+  return out;
+}
+
+vector<int> labels_from_results(plan_t const& q, vector<int> const& res) {
+  // a bad reply of the server, not a bug: left to the retries
+  size_t expected = q.size() + 1;
+  for(auto const& step : q) if(step[1] != -1) expected += 1;
+  if(res.size() != expected) {
+    throw api_error("explore: " + to_string(res.size()) + " labels for a plan of "
+                    + to_string(expected));
+  }
+  int at = 1;
+  vector<int> out;
+  out.pb(res[0]);
+  FOR(j, q.size()) {
+    out.pb(res[at]);
+    if(q[j][1] != -1) at += 1;
+    at += 1;
+  }
+  return out;
+}
@@ -0,0 +1,20 @@
+#pragma once
+
+#include "layout.hpp"
+
+// plans as sent to the server: "0[1]23", doors each optionally followed by
+// a charcoal write
+string plan_to_string(plan_t const& q);
+plan_t plan_from_string(string const& s);
+// server results (which echo the written labels) -> one label per step;
+// api_error if their number does not fit the plan
+vector<int> labels_from_results(plan_t const& q, vector<int> const& res);
+
+struct QUERIES {
+  virtual vector<vector<int>> query(vector<vector<array<int,2>>> const& q) const = 0;
+};
+
+struct queries_t {
+  vector<vector<array<int,2>>> queries;
+  vector<vector<int>> answers;
+};
@@ -0,0 +1,116 @@
+#include "record.hpp"
+#include "api.hpp"
+
+static FILE* record_file = nullptr;
+static mutex record_mutex;
+
+void api_record(string const& path) {
+  lock_guard<mutex> lock(record_mutex);
+  runtime_assert(!record_file);
+  record_file = fopen(path.c_str(), "a");
+  runtime_assert(record_file);
+}
+
+void record_select(string const& problem) {
+  if(!record_file) return;
+  lock_guard<mutex> lock(record_mutex);
+  fprintf(record_file, "S %s\n", problem.c_str());
+  fflush(record_file);
+}
+
+void record_explore(vector<string> const& plans, vector<vector<int>> const& results) {
+  if(!record_file) return;
+  string out = "E " + to_string(plans.size()) + "\n";
+  FOR(i, plans.size()) {
+    out += plans[i];
+    out += ' ';
+    for(int x : results[i]) out += ('0'+x);
+    out += '\n';
+  }
+  lock_guard<mutex> lock(record_mutex);
+  fputs(out.c_str(), record_file);
+  fflush(record_file);
+}
+
+void record_trial(vector<plan_t> const& plans) {
+  if(!record_file) return;
+  string out = "T " + to_string(plans.size()) + "\n";
+  for(auto const& p : plans) {
+    out += plan_to_string(p);
+    out += '\n';
+  }
+  lock_guard<mutex> lock(record_mutex);
+  fputs(out.c_str(), record_file);
+  fflush(record_file);
+}
+
+void record_guess(layout const& L, bool correct) {
+  if(!record_file) return;
+  lock_guard<mutex> lock(record_mutex);
+  fprintf(record_file, "G %d %016llx\n", (int)correct,
+          (unsigned long long)L.canonical_hash());
+  fflush(record_file);
+}
+
+optional<u64> api_log::problem::solution() const {
+  for(auto const& g : guesses) if(g.correct) return g.hash;
+  return nullopt;
+}
+
+void api_log::load(string const& path) {
+  ifstream is(path);
+  runtime_assert(is.good());
+  string type;
+  while(is >> type) {
+    if(type == "S") {
+      problems.eb();
+      auto& P = problems.back();
+      is >> P.name;
+      runtime_assert(find_problem(P.name, P.size, P.num_dups));
+    }else if(type == "E") {
+      runtime_assert(!problems.empty());
+      int n; is >> n;
+      explore e;
+      FOR(i, n) {
+        string plan, res;
+        is >> plan >> res;
+        e.plans.pb(plan);
+        e.results.eb();
+        for(char c : res) e.results.back().pb(c - '0');
+      }
+      problems.back().explores.pb(e);
+    }else if(type == "T") {
+      runtime_assert(!problems.empty());
+      int n; is >> n;
+      vector<string> plans(n);
+      for(auto& p : plans) is >> p;
+      problems.back().trials.pb(plans);
+    }else if(type == "G") {
+      runtime_assert(!problems.empty());
+      guess g;
+      string hash;
+      is >> g.correct >> hash;
+      g.after = problems.back().explores.size();
+      g.hash = stoull(hash, nullptr, 16);
+      problems.back().guesses.pb(g);
+    }else{
+      runtime_assert(false);
+    }
+  }
+}
+
+replay_queries::replay_queries(api_log::problem const& P) {
+  for(auto const& e : P.explores) FOR(i, e.plans.size()) {
+    results[e.plans[i]] = e.results[i];
+  }
+}
+
+vector<vector<int>> replay_queries::query(vector<vector<array<int,2>>> const& q) const {
+  vector<vector<int>> out;
+  for(auto const& v : q) {
+    auto it = results.find(plan_to_string(v));
+    runtime_assert(it != results.end());
+    out.pb(labels_from_results(v, it->second));
+  }
+  return out;
+}
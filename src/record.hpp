@@ -0,0 +1,54 @@
+#pragma once
+
+#include "queries.hpp"
+
+// Log of the API traffic (record=path), one record per line:
+//   S <problem>
+//   E <number of plans>, then "<plan> <results>" per plan, the results as
+//     returned by the server (written labels echoed) as a string of digits
+//   G <correct> <canonical hash of the guessed layout, hex>
+//   T <number of plans>, then one plan per line: the observations solved
+//     together by a trial (kept ones included), since the last select
+void api_record(string const& path);
+void record_select(string const& problem);
+void record_explore(vector<string> const& plans, vector<vector<int>> const& results);
+void record_trial(vector<plan_t> const& plans);
+void record_guess(layout const& L, bool correct);
+
+struct api_log {
+  struct explore {
+    vector<string> plans;
+    vector<vector<int>> results;
+  };
+
+  struct guess {
+    int after; // number of explores before it
+    bool correct;
+    u64 hash;
+  };
+
+  struct problem {
+    string name;
+    int size = 0, num_dups = 0;
+    vector<explore> explores;
+    vector<guess> guesses;
+    vector<vector<string>> trials; // plans of every trial, if recorded
+
+    // canonical hash of the map, if one of the guesses was correct
+    optional<u64> solution() const;
+  };
+
+  vector<problem> problems;
+
+  void load(string const& path);
+};
+
+// Serves the recorded answers of one problem without the network; every
+// plan asked for must have been recorded.
+struct replay_queries : QUERIES {
+  map<string, vector<int>> results;
+
+  replay_queries(api_log::problem const& P);
+
+  virtual vector<vector<int>> query(vector<vector<array<int,2>>> const& q) const override final;
+};
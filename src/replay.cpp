@@ -0,0 +1,131 @@
+#include "replay.hpp"
+#include <immintrin.h>
+
+int replay_engine::add(layout const& L) {
+  int off = num_rooms;
+  int n = L.size * L.num_dups;
+  num_rooms += n;
+  next.resize(W * num_rooms);
+  lane_tag.resize(W * num_rooms);
+  FOR(x, n) {
+    FOR(k, 6) next[W*(off+x)+k] = W * (off + L.graph[x][k]);
+    FOR(l, W) lane_tag[W*(off+x)+l] = L.tag[x];
+  }
+  starts.pb(W * (off + L.start));
+  return starts.size() - 1;
+}
+
+vector<int> replay_engine::evaluate(int which, plan_t const& q) {
+  // lane 0 of lane_tag doubles as the scalar state
+  vector<int> out; out.reserve(q.size()+1);
+  int x = starts[which];
+  out.pb(lane_tag[x]);
+  for(auto [i,t] : q) {
+    x = next[x+i];
+    out.pb(lane_tag[x]);
+    if(t != -1) { undo.pb(x); undo.pb(lane_tag[x]); lane_tag[x] = t; }
+  }
+  while(!undo.empty()) {
+    int v = undo.back(); undo.pop_back();
+    lane_tag[undo.back()] = v; undo.pop_back();
+  }
+  return out;
+}
+
+vector<vector<int>> replay_engine::evaluate(int which, vector<plan_t> const& qs) {
+  return evaluate(vector<int>(qs.size(), which), qs);
+}
+
+vector<vector<int>> replay_engine::evaluate
+(vector<int> const& which, vector<plan_t> const& qs)
+{
+  runtime_assert(which.size() == qs.size());
+  int n = qs.size();
+  vector<vector<int>> out(n);
+  for(int i = 0; i < n; i += W) {
+    int cnt = min(W, n-i);
+    plan_t const* P[W];
+    FOR(l, cnt) P[l] = &qs[i+l];
+    run_batch(which.data() + i, P, cnt, out.data() + i);
+  }
+  return out;
+}
+
+void replay_engine::run_batch(int const* which, plan_t const* const* qs, int cnt,
+                              vector<int>* out)
+{
+  int len = 0;
+  int m[W];
+  FOR(l, W) {
+    m[l] = l < cnt ? qs[l]->size() : 0;
+    len = max(len, m[l]);
+  }
+
+  alignas(32) int x[W];
+  FOR(l, W) x[l] = starts[which[min(l, cnt-1)]];
+  FOR(l, cnt) {
+    out[l].resize(m[l]+1);
+    out[l][0] = lane_tag[x[l]+l];
+  }
+
+#ifdef __AVX2__
+  __m256i lane = _mm256_setr_epi32(0,1,2,3,4,5,6,7);
+  __m256i none = _mm256_set1_epi32(-1);
+  __m256i vx = _mm256_load_si256((__m256i const*)x);
+#endif
+
+  // the plans are transposed B steps at a time, so that the step-major
+  // doors, writes and answers stay in L1
+  constexpr int B = 64;
+  alignas(32) int door[W*B], write[W*B], ans[W*B];
+  for(int j0 = 0; j0 < len; j0 += B) {
+    int b = min(B, len-j0);
+    FOR(j, b) FOR(l, W) {
+      // idle and finished lanes keep walking door 0 without writing
+      bool ok = j0+j < m[l];
+      door[W*j+l] = ok ? (*qs[l])[j0+j][0] : 0;
+      write[W*j+l] = ok ? (*qs[l])[j0+j][1] : -1;
+    }
+
+    FOR(j, b) {
+#ifdef __AVX2__
+      __m256i vd = _mm256_load_si256((__m256i const*)(door + W*j));
+      vx = _mm256_i32gather_epi32(next.data(), _mm256_add_epi32(vx, vd), 4);
+      __m256i vt = _mm256_i32gather_epi32(lane_tag.data(), _mm256_add_epi32(vx, lane), 4);
+      _mm256_store_si256((__m256i*)(ans + W*j), vt);
+      // writes are sparse: scatter them by hand
+      __m256i vwr = _mm256_load_si256((__m256i const*)(write + W*j));
+      int mask = _mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpgt_epi32(vwr, none)));
+      if(mask) {
+        _mm256_store_si256((__m256i*)x, vx);
+        while(mask) {
+          int l = __builtin_ctz(mask); mask &= mask-1;
+          int s = x[l]+l;
+          undo.pb(s); undo.pb(lane_tag[s]);
+          lane_tag[s] = write[W*j+l];
+        }
+      }
+#else
+      FOR(l, W) {
+        x[l] = next[x[l]+door[W*j+l]];
+        int s = x[l]+l;
+        ans[W*j+l] = lane_tag[s];
+        if(write[W*j+l] != -1) {
+          undo.pb(s); undo.pb(lane_tag[s]);
+          lane_tag[s] = write[W*j+l];
+        }
+      }
+#endif
+    }
+
+    FOR(l, cnt) {
+      int e = min(b, m[l]-j0);
+      FOR(j, e) out[l][j0+j+1] = ans[W*j+l];
+    }
+  }
+
+  while(!undo.empty()) {
+    int v = undo.back(); undo.pop_back();
+    lane_tag[undo.back()] = v; undo.pop_back();
+  }
+}
@@ -0,0 +1,33 @@
+#pragma once
+#include "layout.hpp"
+
+// Replays plans (door, charcoal) against one or several layouts stored
+// flat over the concatenated rooms. Rooms are kept as x*W so that both
+// next[x*W+k] (= y*W, doors padded to W) and lane_tag[x*W+lane] are plain
+// additions. Batches run W plans side by side (AVX2 gathers when
+// available); writes are reverted from an undo log instead of copying the
+// labels per plan.
+struct replay_engine {
+  static constexpr int W = 8;
+
+  int num_rooms = 0;
+  vector<int> next;
+  vector<int> starts; // layout -> global start room, times W
+  vector<int> lane_tag;
+  vector<int> undo;   // touched lane_tag slots, with the old label
+
+  replay_engine() { }
+  replay_engine(layout const& L) { add(L); }
+
+  // returns the index of the layout in the engine
+  int add(layout const& L);
+
+  vector<int> evaluate(int which, plan_t const& q);
+  vector<vector<int>> evaluate(int which, vector<plan_t> const& qs);
+  // qs[i] is replayed against layout which[i]
+  vector<vector<int>> evaluate(vector<int> const& which, vector<plan_t> const& qs);
+
+private:
+  void run_batch(int const* which, plan_t const* const* qs, int cnt,
+                 vector<int>* out);
+};
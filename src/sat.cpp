@@ -0,0 +1,182 @@
+#include "sat.hpp"
+#include "trace.hpp"
+#include <unistd.h>
+
+static const char* profiles[] = { "default", "sat", "unsat" };
+
+static bool stopped(sat_config const& config) {
+  if(config.stop && config.stop->load(memory_order_relaxed)) return true;
+  return chrono::steady_clock::now() >= config.deadline;
+}
+
+static int should_terminate(void* state) {
+  auto S = (sat_solver const*)state;
+  if(S->done.load(memory_order_relaxed)) return 1;
+  return stopped(S->config);
+}
+
+sat_solver::sat_solver(sat_config const& config_) : config(config_) {
+  runtime_assert(config.portfolio >= 1);
+  FOR(i, config.portfolio) {
+    kissat* s = kissat_init();
+    kissat_set_option(s, "quiet", 1);
+    if(config.portfolio > 1) {
+      kissat_set_configuration(s, profiles[i % 3]);
+      kissat_set_option(s, "seed", (int)((config.seed + i) & 0x7fffffff));
+      if(i / 3 % 2) kissat_set_option(s, "phase", 0);
+    }
+    if(config.conflicts >= 0) kissat_set_conflict_limit(s, config.conflicts);
+    kissat_set_terminate(s, this, should_terminate);
+    solvers.pb(s);
+  }
+  if(solvers.size() == 1) direct = solvers[0];
+}
+
+sat_solver::~sat_solver() {
+  for(kissat* s : solvers) kissat_release(s);
+}
+
+// kissat only prints its statistics: capture them from stdout and keep the
+// "c name: value" lines. stdout is redirected process-wide: the captures
+// are serialized, and nothing else writes to stdout while the solvers are
+// quiet, so the threads of a parallel run each get their own statistics.
+static vector<pair<string, f64>> kissat_statistics(kissat* s) {
+  static mutex m;
+  lock_guard<mutex> lock(m);
+  vector<pair<string, f64>> out;
+  fflush(stdout);
+  FILE* tmp = tmpfile();
+  if(!tmp) return out;
+  int saved = dup(1);
+  dup2(fileno(tmp), 1);
+  // kissat prints nothing at all when quiet (verbosity below 0)
+  kissat_set_option(s, "quiet", 0);
+  kissat_set_option(s, "statistics", 1);
+  kissat_print_statistics(s);
+  kissat_set_option(s, "quiet", 1);
+  fflush(stdout);
+  dup2(saved, 1);
+  close(saved);
+  rewind(tmp);
+  char line[512];
+  while(fgets(line, sizeof(line), tmp)) {
+    char name[128];
+    double value;
+    if(sscanf(line, "c %127[a-z_-]: %lf", name, &value) == 2) out.eb(name, value);
+  }
+  fclose(tmp);
+  return out;
+}
+
+int sat_solver::solve() {
+  runtime_assert(winner == -1);
+  int res = run();
+  if(trace_enabled()) {
+    auto stats = kissat_statistics(solvers[winner]);
+    stats.eb("result", res);
+    stats.eb("winner", winner);
+    trace_counter("kissat", stats);
+  }
+  return res;
+}
+
+int sat_solver::run() {
+  trace_scope scope("kissat_solve");
+  if(solvers.size() == 1) {
+    int res = kissat_solve(solvers[0]);
+    winner = 0;
+    return res;
+  }
+
+  int res = 0;
+  mutex m;
+  vector<thread> threads;
+  FOR(i, solvers.size()) threads.eb([&, i]() {
+    int r = kissat_solve(solvers[i]);
+    if(r == 0) return;
+    lock_guard<mutex> lock(m);
+    if(winner == -1) {
+      winner = i;
+      res = r;
+      done = true;
+    }
+  });
+  for(auto& t : threads) t.join();
+  if(winner == -1) winner = 0;
+  return res;
+}
+
+// Not incremental: kissat takes no clauses after kissat_solve, so every
+// solve starts a fresh sat_solver from the clauses logged so far. Limits
+// and portfolio are those of config.
+struct kissat_reload : sat_session {
+  clause_log log;
+  unique_ptr<sat_solver> last;
+
+  kissat_reload(sat_config const& config_) : sat_session(config_) { }
+
+  void add_clause(int const* lits, int n) override { log.add_clause(lits, n); }
+
+  int solve() override {
+    last = make_unique<sat_solver>(config);
+    log.load(*last);
+    return last->solve();
+  }
+
+  int value(int lit) const override {
+    runtime_assert(last);
+    return last->value(lit);
+  }
+};
+
+#ifdef USE_IPASIR
+extern "C" {
+  void* ipasir_init();
+  void ipasir_release(void* solver);
+  void ipasir_add(void* solver, int32_t lit);
+  int ipasir_solve(void* solver);
+  int32_t ipasir_val(void* solver, int32_t lit);
+  void ipasir_set_terminate(void* solver, void* data, int (*terminate)(void* data));
+}
+
+// One solver for the whole session. IPASIR has no conflict limit and no
+// portfolio: make_sat_session only picks it when config asks for neither.
+struct ipasir_session : sat_session {
+  void* solver;
+  bool solved = false;
+
+  ipasir_session(sat_config const& config_)
+    : sat_session(config_), solver(ipasir_init()) {
+    ipasir_set_terminate(solver, this, [](void* state) -> int {
+      return stopped(((ipasir_session const*)state)->config);
+    });
+  }
+  ~ipasir_session() { ipasir_release(solver); }
+
+  void add_clause(int const* lits, int n) override {
+    FOR(i, n) ipasir_add(solver, lits[i]);
+    ipasir_add(solver, 0);
+  }
+
+  int solve() override {
+    runtime_assert(config.conflicts < 0 && config.portfolio == 1);
+    trace_scope scope("ipasir_solve");
+    solved = true;
+    return ipasir_solve(solver);
+  }
+
+  int value(int lit) const override {
+    runtime_assert(solved);
+    return ipasir_val(solver, lit);
+  }
+};
+#endif
+
+unique_ptr<sat_session> make_sat_session(sat_config const& config) {
+#ifdef USE_IPASIR
+  if(config.conflicts < 0 && config.portfolio == 1) {
+    return make_unique<ipasir_session>(config);
+  }
+#endif
+  return make_unique<kissat_reload>(config);
+}
@@ -0,0 +1,104 @@
+#pragma once
+
+#include "kissat.h"
+
+struct clause_sink {
+  // set by sinks that are a single kissat instance, which then gets its
+  // clauses straight from cnf_builder instead of through add_clause
+  kissat* direct = nullptr;
+
+  virtual ~clause_sink() = default;
+  // a whole clause, without the terminating 0
+  virtual void add_clause(int const* lits, int n) = 0;
+};
+
+struct sat_config {
+  int portfolio = 1; // number of racing kissat instances
+  u64 seed = 0;
+  i64 conflicts = -1; // per instance and solve, -1 for no limit
+  atomic<bool> const* stop = nullptr;
+  chrono::steady_clock::time_point deadline = chrono::steady_clock::time_point::max();
+};
+
+// Wraps one or several kissat instances fed with the same CNF. With
+// portfolio > 1 the instances use different seeds and option profiles and
+// race on separate threads; the first answer wins and the others are
+// stopped through the terminate hook.
+struct sat_solver : clause_sink {
+  sat_config config;
+  vector<kissat*> solvers;
+  atomic<bool> done = false;
+  int winner = -1;
+
+  sat_solver(sat_config const& config_);
+  ~sat_solver();
+
+  sat_solver(sat_solver const&) = delete;
+  sat_solver& operator=(sat_solver const&) = delete;
+
+  void add_clause(int const* lits, int n) override {
+    for(kissat* s : solvers) {
+      FOR(i, n) kissat_add(s, lits[i]);
+      kissat_add(s, 0);
+    }
+  }
+
+  // 10 (SAT), 20 (UNSAT) or 0 (stopped, or out of conflicts); when
+  // tracing, the statistics of the winning instance are written to the
+  // trace afterwards, on the calling thread
+  int solve();
+
+  int value(int lit) const {
+    return kissat_value(solvers[winner], lit);
+  }
+
+private:
+  int run();
+};
+
+// Clauses kept in memory so that they can be loaded into fresh solvers,
+// kissat being unable to take new clauses after kissat_solve.
+struct clause_log : clause_sink {
+  vector<int> lits; // 0-terminated clauses
+
+  void add_clause(int const* lits_, int n) override {
+    lits.insert(lits.end(), lits_, lits_ + n);
+    lits.pb(0);
+  }
+
+  void load(clause_sink& solver) const {
+    size_t i = 0;
+    while(i < lits.size()) {
+      size_t j = i;
+      while(lits[j] != 0) j += 1;
+      solver.add_clause(lits.data() + i, j - i);
+      i = j + 1;
+    }
+  }
+};
+
+// Clauses accumulated over several solves, added between them. Whether the
+// solver state survives between solves depends on the backend.
+//
+// Only the lazy mode of solve_base uses it. The other repeated solves
+// cannot share a solver: the adaptive loop re-derives the trie, clique
+// anchors, quotient and domains from all the observations at every trial,
+// so no variable of the previous formula carries over; check_unique's
+// rounds only add exclusion clauses, but run with a conflict limit
+// (unique_conflicts), which IPASIR cannot honour, and kissat takes no
+// clauses after a solve.
+struct sat_session : clause_sink {
+  sat_config config; // read at every solve
+
+  sat_session(sat_config const& config_) : config(config_) { }
+
+  // as sat_solver::solve
+  virtual int solve() = 0;
+  // only after a solve
+  virtual int value(int lit) const = 0;
+};
+
+// A truly incremental IPASIR solver when built with one (USE_IPASIR) and
+// config sets no conflict limit and no portfolio. Otherwise kissat, loaded
+// again from all the clauses at every solve: correct, not incremental.
+unique_ptr<sat_session> make_sat_session(sat_config const& config);
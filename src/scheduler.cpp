@@ -0,0 +1,38 @@
+#include "scheduler.hpp"
+#include "trace.hpp"
+
+scheduler::scheduler(f64 budget_, int size, int num_dups)
+  : start(clock::now()), budget(budget_)
+{
+  f64 n = size * num_dups;
+  expected[(int)solve_stage::base] = 2e-4 * n * n;
+  expected[(int)solve_stage::dup] = 1e-4 * n * n;
+  expected[(int)solve_stage::joint] = 3e-4 * n * n;
+}
+
+f64 scheduler::elapsed() const {
+  return chrono::duration<f64>(clock::now() - start).count();
+}
+
+bool scheduler::expired() const {
+  return budget > 0 && elapsed() >= budget;
+}
+
+scheduler::clock::time_point scheduler::slice(solve_stage s) const {
+  f64 t;
+  {
+    lock_guard<mutex> lock(m);
+    t = clamp(margin * expected[(int)s], min_slice, max_slice);
+  }
+  if(budget > 0) smin(t, max(0.0, budget - elapsed()));
+  return clock::now() + chrono::duration_cast<clock::duration>(chrono::duration<f64>(t));
+}
+
+void scheduler::record(solve_stage s, f64 seconds) {
+  lock_guard<mutex> lock(m);
+  int i = (int)s;
+  // the prior only stands for the first solve
+  expected[i] = count[i] == 0 ? seconds : 0.8 * expected[i] + 0.2 * seconds;
+  count[i] += 1;
+  trace_counter("scheduler", {{"base", expected[0]}, {"dup", expected[1]}, {"joint", expected[2]}});
+}
@@ -0,0 +1,32 @@
+#pragma once
+
+enum struct solve_stage { base, dup, joint };
+
+// Wall-clock budget of a run, and the time slices of the solver calls in
+// it. A slice is margin times the expected time of the stage (a moving
+// average of its past solves, or a prior in size*num_dups before the
+// first one), within [min_slice, max_slice] and the time left. Solves
+// running past their slice are stopped through kissat's terminate hook,
+// so that a pathological trial is given up for a fresh one. main only
+// installs it when budget= or a slice_ option is given.
+struct scheduler {
+  using clock = chrono::steady_clock;
+
+  clock::time_point start;
+  f64 budget;             // seconds, 0 for none
+  f64 margin = 4;
+  f64 min_slice = 0.5, max_slice = 10;
+  f64 expected[3];           // seconds, per stage
+  int count[3] = {0, 0, 0};  // solves recorded
+  mutable mutex m;
+
+  scheduler(f64 budget_, int size, int num_dups);
+
+  f64 elapsed() const;
+  bool expired() const;
+
+  // deadline for a solve of the stage starting now
+  clock::time_point slice(solve_stage s) const;
+  // time taken by a solve of the stage, stopped or not
+  void record(solve_stage s, f64 seconds);
+};
@@ -0,0 +1,902 @@
+#include "solver.hpp"
+#include "api.hpp"
+#include "trie.hpp"
+#include "trace.hpp"
+
+bool test_equivalence(layout const& a, layout const& b) {
+  runtime_assert(a.size == b.size && a.num_dups == b.num_dups);
+  auto ca = a.canonical();
+  return ca[0] == a.size * a.num_dups && ca == b.canonical();
+}
+
+vector<vector<int>> api_queries::query(vector<vector<array<int,2>>> const& q) const {
+  vector<string> R;
+  for(auto const& v : q) R.pb(plan_to_string(v));
+  auto RET = api_explore(R);
+  vector<vector<int>> out;
+  FOR(i, q.size()) out.pb(labels_from_results(q[i], RET[i]));
+  return out;
+}
+
+vector<optional<answer_mismatch>> verify_layouts(vector<layout> const& candidates, queries_t const& Q) {
+  replay_engine E;
+  vector<int> which;
+  vector<plan_t> plans;
+  for(auto const& L : candidates) {
+    int c = E.add(L);
+    for(auto const& q : Q.queries) {
+      which.pb(c);
+      plans.pb(q);
+    }
+  }
+  auto results = E.evaluate(which, plans);
+
+  int nq = Q.queries.size();
+  vector<optional<answer_mismatch>> out(candidates.size());
+  FOR(c, candidates.size()) FOR(i, nq) {
+    auto const& got = results[c*nq+i];
+    auto const& expected = Q.answers[i];
+    runtime_assert(got.size() == expected.size());
+    FOR(j, got.size()) if(got[j] != expected[j]) {
+      out[c] = answer_mismatch { i, j, expected[j], got[j] };
+      break;
+    }
+    if(out[c]) break;
+  }
+  return out;
+}
+
+optional<answer_mismatch> verify_layout(layout const& L, queries_t const& Q) {
+  return verify_layouts({L}, Q)[0];
+}
+
+// adds the time since the last lap to a field of the stats, if any, and
+// to the trace as a span
+struct stage_timer {
+  solve_stats* stats;
+  timer T;
+  i64 ts;
+
+  stage_timer(solve_stats* stats_) : stats(stats_), ts(trace_now()) { }
+
+  void lap(f64 solve_stats::* field, const char* name) {
+    if(stats) stats->*field += T.elapsed();
+    i64 now = trace_now();
+    trace_complete(name, ts, now - ts);
+    T.reset();
+    ts = now;
+  }
+};
+
+solve_strategy parse_solve_strategy(string const& name) {
+  if(name == "staged") return solve_strategy::staged;
+  if(name == "joint") return solve_strategy::joint;
+  throw runtime_error("unknown strategy: " + name);
+}
+
+// Value precedence on the copies of every base room, fed with the nodes in
+// order: a node is in copy c > 0 only if an earlier node of the same room
+// is in copy c-1, which labels the visited copies in order of first visit.
+struct copy_precedence {
+  cnf_builder& cnf;
+  vector<vector<int>> U; // U[x][c]: copy c of x is used by a node so far
+
+  copy_precedence(cnf_builder& cnf_, int size, int num_dups)
+    : cnf(cnf_), U(size, vector<int>(num_dups)) { }
+
+  // in[c]: the node is in copy c of room x (0 if it cannot be)
+  void node(int x, vector<int> const& in) {
+    FOR(c, in.size()) if(c > 0 && in[c]) {
+      if(U[x][c-1]) cnf.clause({-in[c], U[x][c-1]});
+      else cnf.clause({-in[c]});
+    }
+    FOR(c, in.size()) if(in[c]) {
+      int u = cnf.new_var();
+      if(U[x][c]) cnf.clause({-u, U[x][c], in[c]});
+      else cnf.clause({-u, in[c]});
+      U[x][c] = u;
+    }
+  }
+};
+
+solve_options parse_solve_options(options const& opts) {
+  solve_options opt;
+  opt.strategy = parse_solve_strategy(opts.get_string("strategy", "staged"));
+  opt.sat.portfolio = opts.get_int("portfolio", 1);
+  opt.sat.seed = opts.get_int("seed", time(0));
+  opt.lazy_transitions = opts.get_int("lazy", 0);
+  if(opt.lazy_transitions) check_lazy_options(opt);
+  opt.compact_transitions = opts.get_string("transitions", "direct") == "compact";
+  opt.amo = parse_amo_encoding(opts.get_string("amo", "pairwise"));
+  opt.quotient = opts.get_int("quotient", 1);
+  opt.domains = opts.get_int("domains", 1);
+  opt.verbose = opts.get_int("verbose", 0);
+  opt.design.candidates = opts.get_int("design", 8);
+  opt.design.samples = opts.get_int("design_samples", 4);
+  opt.unique = opts.get_int("unique", 0);
+  opt.unique_rounds = opts.get_int("unique_rounds", 8);
+  opt.unique_conflicts = opts.get_int("unique_conflicts", 1e6);
+  if(opt.strategy == solve_strategy::joint) check_joint_options(opts);
+  return opt;
+}
+
+void check_lazy_options(solve_options const& opt) {
+#ifndef USE_IPASIR
+  throw runtime_error("lazy needs an IPASIR build (IPASIR_LIB)");
+#endif
+  if(opt.sat.portfolio > 1) throw runtime_error("lazy needs portfolio=1");
+}
+
+void check_joint_options(options const& opts) {
+  for(auto name : {"lazy", "transitions", "quotient", "domains"}) {
+    if(opts.has(name)) throw runtime_error(string(name) + " is not supported by strategy=joint");
+  }
+}
+
+queries_t make_queries
+(QUERIES const& Q, int size, int num_dups, int num_queries, f32 ratio_query1, RNG& R,
+ design_options const& design)
+{
+  auto queries = design_plans(size, num_dups, num_queries, ratio_query1, R, design);
+  auto answers = Q.query(queries);
+  return queries_t {
+    queries, answers
+  };
+}
+
+layout solve_base
+(queries_t const& Q, int size, int num_dups, int num_queries,
+ RNG& R, solve_options const& opt)
+{
+  stage_timer ST(opt.stats);
+  auto result = [&](int res) { if(opt.stats) opt.stats->base_result = res; };
+  result(20);
+  obs_trie T;
+  T.build(Q.queries, Q.answers);
+  ST.lap(&solve_stats::t_trie, "trie");
+  auto maxClique = max_clique(T, R);
+  ST.lap(&solve_stats::t_clique, "clique");
+
+  // (the clique is greedy: no proof that there is no layout)
+  if((int)maxClique.size() < size) { result(0); return {}; }
+  vector<int> anchors(maxClique.begin(), maxClique.begin() + size);
+
+  int N = T.N;
+  vector<int> tag = T.tag;
+  vector<array<int, 6>> to = T.to;
+  if(opt.quotient) {
+    trie_quotient TQ;
+    bool ok = TQ.build(T, anchors);
+    ST.lap(&solve_stats::t_quotient, "quotient");
+    if(!ok) return {};
+    N = TQ.N;
+    tag = move(TQ.tag);
+    to = move(TQ.to);
+    for(int& x : maxClique) x = TQ.cls[x];
+  }
+  if(opt.verbose) debug("solve_base trie", T.N, N);
+  trace_counter("solve_base trie", {{"nodes", T.N}, {"classes", N}, {"clique", maxClique.size()}});
+  if(opt.sat.stop && *opt.sat.stop) { result(0); return {}; }
+
+  // feasible rooms of every node: V[i][j] is 0 (false) when j is not in D[i]
+  vector<room_set> D;
+  if(opt.domains) {
+    vector<int> cls_anchors(maxClique.begin(), maxClique.begin() + size);
+    if(!room_domains(N, tag, to, cls_anchors, size, D)) return {};
+  }else{
+    room_set all_rooms;
+    FOR(j, size) all_rooms[j] = 1;
+    D.assign(N, all_rooms);
+  }
+  if(opt.verbose) {
+    i64 total = 0;
+    FOR(i, N) total += D[i].count();
+    debug("solve_base domains", (i64)N*size, total);
+  }
+  ST.lap(&solve_stats::t_reduce, "reduce");
+
+  cnf_builder cnf(opt.amo);
+  vector<vector<int>> V(N, vector<int>(size));
+  FOR(i, N) FOR(j, size) if(D[i][j]) V[i][j] = cnf.new_var();
+  vector<vector<array<int, 6>>> TO(size);
+  FOR(i, size) TO[i].resize(size);
+  FOR(i, size) FOR(j, size) FOR(k, 6) TO[i][j][k] = cnf.new_var();
+
+  // compact encoding: the room of every edge target (L) and the destination
+  // of every door (P) are also written in binary, so that an edge costs
+  // O(size log size) clauses instead of size^2.
+  int nbits = 0;
+  while((1<<nbits) < size) nbits += 1;
+  vector<vector<int>> L(N), P(size*6);
+  vector<char> channelled(N);
+  if(opt.compact_transitions) {
+    FOR(a, size) FOR(k, 6) FOR(t, nbits) P[a*6+k].pb(cnf.new_var());
+    // once per edge target, however many edges lead to it
+    vector<char> target(N);
+    FOR(i, N) FOR(k, 6) if(to[i][k] != -1) target[to[i][k]] = 1;
+    FOR(j, N) if(target[j]) FOR(t, nbits) L[j].pb(cnf.new_var());
+  }
+
+  auto add_core = [&]() {
+    // V[-][-] is the graph of a function.
+    FOR(i, N) {
+      vector<int> row;
+      for(int v : V[i]) if(v) row.pb(v);
+      cnf.exactly_one(row);
+    }
+    // breaking the symmetry using the maximum clique
+    FOR(i, size) cnf.clause({V[maxClique[i]][i]});
+    // if V[i][j] then i mush have the correct label
+    FOR(i, N) FOR(j, size) if(V[i][j] && tag[i] != tag[maxClique[j]]) cnf.clause({-V[i][j]});
+    // TO[-][-][-] is the graph of a function (sending (i,k) to j)
+    FOR(i, size) FOR(k, 6) {
+      vector<int> row(size);
+      FOR(j, size) row[j] = TO[i][j][k];
+      cnf.exactly_one(row);
+    }
+    // if there exists an edge (i -> j), then there exists an edge (j -> i).
+    // (additional constraints would be needed to ensure
+    //  that this correspondence is bijective).
+    FOR(i, size) FOR(j, size) FOR(k, 6) {
+      cnf.add(-TO[i][j][k]);
+      FOR(k2, 6) {
+        cnf.add(TO[j][i][k2]);
+      }
+      cnf.add(0);
+    }
+    // TO[a][b][k] => P[a][k] == b
+    if(opt.compact_transitions) FOR(a, size) FOR(b, size) FOR(k, 6) FOR(t, nbits) {
+      cnf.clause({-TO[a][b][k], getbit(b, t) ? P[a*6+k][t] : -P[a*6+k][t]});
+    }
+  };
+
+  // the excluded layouts, relabelled so that the anchor j is room j
+  auto add_exclusions = [&]() {
+    if(!opt.exclude) return;
+    for(auto const& E : *opt.exclude) {
+      vector<int> room(size, -1);
+      FOR(j, size) {
+        vector<int> path;
+        for(int i = anchors[j]; T.parent[i] != -1; i = T.parent[i]) {
+          FOR(k, 6) if(T.to[T.parent[i]][k] == i) path.pb(k);
+        }
+        reverse(all(path));
+        int x = E.start;
+        for(int k : path) x = E.graph[x][k];
+        runtime_assert(room[x] == -1);
+        room[x] = j;
+      }
+      if(!V[0][room[E.start]]) continue;
+      vector<int> lits = { -V[0][room[E.start]] };
+      FOR(a, size) FOR(k, 6) lits.pb(-TO[room[a]][room[E.graph[a][k]]][k]);
+      cnf.clause(lits);
+    }
+  };
+
+  // if i is in room a and door k goes from a to b, then to[i][k] is in room b
+  auto add_transition = [&](int i, int k, int a) {
+    if(!V[i][a]) return;
+    int j = to[i][k];
+    if(!opt.compact_transitions) {
+      FOR(b, size) {
+        if(V[j][b]) cnf.clause({- TO[a][b][k], - V[i][a], V[j][b]});
+        else cnf.clause({- TO[a][b][k], - V[i][a]});
+      }
+      return;
+    }
+    // V[j][b] => L[j] == b
+    if(!channelled[j]) {
+      channelled[j] = 1;
+      FOR(b, size) if(V[j][b]) FOR(t, nbits) {
+        cnf.clause({-V[j][b], getbit(b, t) ? L[j][t] : -L[j][t]});
+      }
+    }
+    // V[i][a] => L[j] == P[a][k]
+    FOR(t, nbits) {
+      cnf.clause({-V[i][a], -L[j][t], P[a*6+k][t]});
+      cnf.clause({-V[i][a], L[j][t], -P[a*6+k][t]});
+    }
+  };
+
+  auto read_layout = [&](auto const& solver) {
+    layout out_layout;
+    out_layout.size = size;
+    out_layout.num_dups = 1;
+    out_layout.tag.resize(size);
+    FOR(i, size) out_layout.tag[i] = tag[maxClique[i]];
+    out_layout.graph.resize(size);
+    FOR(a, size) FOR(k, 6) FOR(b, size) if(solver.value(TO[a][b][k]) > 0) {
+      out_layout.graph[a][k] = b;
+    }
+    // the starting room is node 0 (trie root, or its class)
+    if(int i = 0; 1) FOR(j, size) if(V[i][j] && solver.value(V[i][j]) > 0) {
+        out_layout.start = j;
+      }
+    return out_layout;
+  };
+
+  auto record_size = [&]() {
+    trace_counter("solve_base cnf", {{"vars", cnf.num_vars}, {"clauses", cnf.num_clauses}});
+    if(!opt.stats) return;
+    opt.stats->base_vars = cnf.num_vars;
+    opt.stats->base_clauses = cnf.num_clauses;
+  };
+
+  // One time slice for the stage, all the rounds of the lazy mode
+  // included. It starts at the first solve: the CNF is written outside of
+  // it.
+  timer T_stage;
+  bool sliced = false;
+  auto start_slice = [&](sat_config& config) {
+    if(sliced) return;
+    sliced = true;
+    if(opt.sched) config.deadline = opt.sched->slice(solve_stage::base);
+    T_stage.reset();
+  };
+  auto record_time = [&]() {
+    if(opt.sched) opt.sched->record(solve_stage::base, T_stage.elapsed());
+  };
+
+  if(!opt.lazy_transitions) {
+    timer T;
+    sat_solver solver(opt.sat);
+    cnf.out = &solver;
+    add_core();
+    add_exclusions();
+    FOR(i, N) FOR(k, 6) if(to[i][k] != -1) {
+      FOR(a, size) add_transition(i, k, a);
+    }
+    if(opt.verbose) debug("solve_base cnf", cnf.num_vars, cnf.num_clauses, T.elapsed());
+    record_size();
+    ST.lap(&solve_stats::t_cnf, "cnf");
+
+    T.reset();
+    start_slice(solver.config);
+    int res = solver.solve();
+    if(opt.verbose) debug("solve_base solve", res, T.elapsed());
+    ST.lap(&solve_stats::t_solve, "solve");
+    result(res);
+    record_time();
+    if(res == 10) return read_layout(solver); // SAT
+    return {};
+  }
+
+  // Lazy mode: start without the transition clauses and add, for every
+  // edge the current model violates, the clauses for its source room. The
+  // final model satisfies every transition clause, so it is a model of the
+  // full encoding. Without an IPASIR backend every round re-solves all the
+  // clauses so far from scratch (see make_sat_session), hence
+  // check_lazy_options.
+  auto solver = make_sat_session(opt.sat);
+  cnf.out = solver.get();
+  add_core();
+  add_exclusions();
+  while(1) {
+    record_size();
+    ST.lap(&solve_stats::t_cnf, "cnf");
+
+    start_slice(solver->config);
+    int res = solver->solve();
+    if(opt.verbose) debug("solve_base lazy", res, cnf.num_vars, cnf.num_clauses);
+    ST.lap(&solve_stats::t_solve, "solve");
+    result(res);
+    if(res != 10) { record_time(); return {}; }
+
+    vector<int> room(N);
+    FOR(i, N) FOR(j, size) if(V[i][j] && solver->value(V[i][j]) > 0) room[i] = j;
+    vector<array<int, 6>> next(size);
+    FOR(a, size) FOR(k, 6) FOR(b, size) if(solver->value(TO[a][b][k]) > 0) {
+      next[a][k] = b;
+    }
+
+    int num_violated = 0;
+    FOR(i, N) FOR(k, 6) if(to[i][k] != -1) {
+      if(room[to[i][k]] == next[room[i]][k]) continue;
+      num_violated += 1;
+      add_transition(i, k, room[i]);
+    }
+    if(num_violated == 0) { record_time(); return read_layout(*solver); }
+  }
+}
+
+layout solve_dup
+(queries_t const& Q, int size, int num_dups, int num_queries, layout const& base_layout,
+ solve_options const& opt)
+{
+  stage_timer ST(opt.stats);
+  auto result = [&](int res) { if(opt.stats) opt.stats->dup_result = res; };
+  result(20);
+  auto queries = Q.queries;
+  auto answers = Q.answers;
+  int query_size = queries[0].size();
+
+  int N = 0;
+  vector<array<int, 6>> to;
+  vector<int> at;
+  vector<int> is_start;
+  vector<vector<int>> rev(num_queries);
+  FOR(i, num_queries) {
+    int x = base_layout.start;
+    at.pb(x);
+    is_start.pb(1);
+    FOR(j, query_size+1) {
+      if(j < query_size) {
+        x = base_layout.graph[x][queries[i][j][0]];
+        at.pb(x);
+        is_start.pb(0);
+      }
+      to.pb({-1,-1,-1,-1,-1,-1});
+      rev[i].pb(N);
+      N += 1;
+      if(j < query_size) to.back()[queries[i][j][0]] = N;
+    }
+  }
+
+  // pairs of nodes that are different copies of the same base room
+  vector<array<int, 2>> differ;
+  FOR(i, num_queries) {
+    vector<vector<array<int,3>>> X(size);
+    FOR(j, query_size) {
+      int ans = answers[i][j+1];
+      int wrote = queries[i][j][1] == -1 ? ans : queries[i][j][1];
+      int when = rev[i][j+1];
+      int elem = at[when];
+      int k = X[elem].size()-1;
+      while(k >= 0 && X[elem][k][2] != ans) {
+        // we learn that "X[elem][k][0]" and "when" are different
+        // copies of the same node from the base graph
+        differ.pb({X[elem][k][0], when});
+        k -= 1;
+      }
+      X[elem].pb({when, ans, wrote});
+    }
+  }
+
+  // feasible copies of every node (bitmask), reduced to arc consistency:
+  // a fixed copy is excluded from the nodes that differ from it, and the
+  // successors through the same door of nodes fixed to the same copy of
+  // the same base room share their copy (and avoid the successor copies
+  // of the other copies).
+  const int all_copies = (1<<num_dups)-1;
+  vector<int> D(N, all_copies);
+  FOR(i, N) if(is_start[i]) D[i] = 1;
+  if(opt.domains) {
+    vector<int> succ(size*num_dups*6);
+    bool changed = true;
+    while(changed) {
+      changed = false;
+      auto restrict = [&](int i, int mask) {
+        if((D[i] & mask) != D[i]) {
+          D[i] &= mask;
+          changed = true;
+        }
+      };
+      for(auto [u, v] : differ) {
+        if(popcount(D[u]) == 1) restrict(v, ~D[u]);
+        if(popcount(D[v]) == 1) restrict(u, ~D[v]);
+      }
+      fill(all(succ), all_copies);
+      FOR(i, N) if(popcount(D[i]) == 1) FOR(k, 6) if(to[i][k] != -1) {
+        succ[(at[i]*num_dups + lsb(D[i]))*6 + k] &= D[to[i][k]];
+      }
+      // door k is a bijection between the copies of two base rooms
+      FOR(x, size) FOR(k, 6) FOR(a, num_dups) {
+        int m = succ[(x*num_dups + a)*6 + k];
+        if(popcount(m) == 1) FOR(b, num_dups) if(b != a) succ[(x*num_dups + b)*6 + k] &= ~m;
+      }
+      FOR(i, N) if(popcount(D[i]) == 1) FOR(k, 6) if(to[i][k] != -1) {
+        restrict(to[i][k], succ[(at[i]*num_dups + lsb(D[i]))*6 + k]);
+      }
+      FOR(i, N) if(D[i] == 0) { ST.lap(&solve_stats::t_dup_cnf, "dup cnf"); return {}; }
+    }
+  }
+  if(opt.verbose) {
+    i64 total = 0;
+    FOR(i, N) total += popcount(D[i]);
+    debug("solve_dup domains", (i64)N*num_dups, total);
+  }
+
+  if(opt.sat.stop && *opt.sat.stop) { result(0); return {}; }
+
+  sat_solver solver(opt.sat);
+  cnf_builder cnf(opt.amo, &solver);
+
+  // V[i][a] is 0 (false) when a is not in D[i]
+  vector<vector<int>> V(N, vector<int>(num_dups));
+  FOR(i, N) FOR(j, num_dups) if(getbit(D[i], j)) V[i][j] = cnf.new_var();
+  vector<vector<vector<array<int, 6>>>> TO(size);
+  FOR(i, size) TO[i].resize(num_dups);
+  FOR(i, size) FOR(a, num_dups) TO[i][a].resize(num_dups);
+  FOR(i, size) FOR(a, num_dups) FOR(b, num_dups) FOR(k, 6) TO[i][a][b][k] = cnf.new_var();
+
+  FOR(i, N) {
+    vector<int> row;
+    for(int v : V[i]) if(v) row.pb(v);
+    cnf.exactly_one(row);
+  }
+  FOR(i, size) FOR(k, 6) {
+    FOR(a, num_dups) {
+      vector<int> fwd(num_dups), bwd(num_dups);
+      FOR(b, num_dups) {
+        fwd[b] = TO[i][a][b][k];
+        bwd[b] = TO[i][b][a][k];
+      }
+      cnf.exactly_one(fwd);
+      cnf.exactly_one(bwd);
+    }
+  }
+  FOR(i, N) FOR(a, num_dups) FOR(b, num_dups) FOR(k, 6) if(to[i][k] != -1 && V[i][a]) {
+    if(V[to[i][k]][b]) cnf.clause({- TO[at[i]][a][b][k], - V[i][a], V[to[i][k]][b]});
+    else cnf.clause({- TO[at[i]][a][b][k], - V[i][a]});
+  }
+  FOR(i, N) if(is_start[i]) {
+    cnf.clause({V[i][0]});
+  }
+  for(auto [u, v] : differ) FOR(a, num_dups) if(V[u][a] && V[v][a]) {
+    cnf.clause({- V[u][a], - V[v][a]});
+  }
+
+  FOR(i, size) FOR(k, 6) FOR(a, num_dups) FOR(b, num_dups) {
+    int j = base_layout.graph[i][k];
+    cnf.add(-TO[i][a][b][k]);
+    FOR(k2, 6) if(base_layout.graph[j][k2] == i) {
+      cnf.add(TO[j][b][a][k2]);
+    }
+    cnf.add(0);
+  }
+
+  // the excluded layouts are compared up to a relabelling of the copies:
+  // the start nodes are in copy 0 (as in the domain reduction), the other
+  // copies of every base room are labelled in the order in which the walks
+  // reach them, here and in the blocking clauses. Not used otherwise: it
+  // slowed down the SAT and the UNSAT solves alike
+  if(opt.exclude) {
+    copy_precedence P(cnf, size, num_dups);
+    FOR(i, N) P.node(at[i], V[i]);
+
+    for(auto const& E : *opt.exclude) {
+      runtime_assert(E.start == base_layout.start);
+      // copies of every base room in order of first visit, then the others
+      vector<vector<int>> copy(size, vector<int>(num_dups, -1));
+      vector<int> num_seen(size);
+      auto visit = [&](int y) {
+        int& c = copy[y % size][y / size];
+        if(c == -1) c = num_seen[y % size]++;
+      };
+      FOR(i, num_queries) {
+        int y = E.start;
+        visit(y);
+        FOR(j, query_size) {
+          y = E.graph[y][queries[i][j][0]];
+          visit(y);
+        }
+      }
+      FOR(x, size) FOR(a, num_dups) if(copy[x][a] == -1) visit(x + a*size);
+
+      vector<int> lits;
+      FOR(x, size) FOR(a, num_dups) FOR(k, 6) {
+        int y = E.graph[x + a*size][k];
+        runtime_assert(y % size == base_layout.graph[x][k]);
+        lits.pb(-TO[x][copy[x][a]][copy[y % size][y / size]][k]);
+      }
+      cnf.clause(lits);
+    }
+  }
+  if(opt.verbose) debug("solve_dup cnf", cnf.num_vars, cnf.num_clauses);
+  trace_counter("solve_dup cnf", {{"nodes", N}, {"vars", cnf.num_vars}, {"clauses", cnf.num_clauses}});
+  if(opt.stats) {
+    opt.stats->dup_vars = cnf.num_vars;
+    opt.stats->dup_clauses = cnf.num_clauses;
+  }
+  ST.lap(&solve_stats::t_dup_cnf, "dup cnf");
+
+  // the time slice is for the solve only
+  if(opt.sched) solver.config.deadline = opt.sched->slice(solve_stage::dup);
+  timer T_stage;
+  int res = solver.solve();
+  ST.lap(&solve_stats::t_dup_solve, "dup solve");
+  result(res);
+  if(opt.sched) opt.sched->record(solve_stage::dup, T_stage.elapsed());
+
+  if(res == 10) {
+    layout out_layout;
+    out_layout.size = size;
+    out_layout.num_dups = num_dups;
+    out_layout.tag.resize(size * num_dups);
+    out_layout.graph.resize(size * num_dups);
+    out_layout.start = base_layout.start;
+
+    FOR(i, size*num_dups) out_layout.tag[i] = base_layout.tag[i%size];
+
+    FOR(i, size) FOR(a, num_dups) FOR(k, 6) FOR(b, num_dups) {
+      if(solver.value(TO[i][a][b][k]) > 0) {
+        out_layout.graph[i+a*size][k] = base_layout.graph[i][k]+b*size;
+      }
+    }
+
+    return out_layout;
+  }
+  return {};
+}
+
+layout solve_joint
+(queries_t const& Q, int size, int num_dups, int num_queries,
+ RNG& R, solve_options const& opt)
+{
+  runtime_assert(!opt.exclude && !opt.lazy_transitions && !opt.compact_transitions);
+  stage_timer ST(opt.stats);
+  auto result = [&](int res) { if(opt.stats) opt.stats->joint_result = res; };
+  result(0);
+  auto const& queries = Q.queries;
+  auto const& answers = Q.answers;
+
+  // the base rooms are anchored to a clique of the write-free prefixes as
+  // in solve_base, which also gives their labels
+  obs_trie T;
+  T.build(queries, answers);
+  auto clique = max_clique(T, R);
+  if((int)clique.size() < size) { ST.lap(&solve_stats::t_joint, "solve_joint"); return {}; }
+  vector<int> base_tag(size);
+  FOR(x, size) base_tag[x] = T.tag[clique[x]];
+
+  // step j of query i is node first[i]+j (the room after j doors). Trie
+  // nodes are the same nodes until the first step with a write, and the
+  // room of that step is still seen with its original label (orig).
+  vector<int> first, ans, orig;
+  vector<int> trie_node;
+  FOR(i, num_queries) {
+    first.pb(ans.size());
+    bool clean = true; // no write in the steps so far
+    FOR(j, queries[i].size()+1) {
+      ans.pb(answers[i][j]);
+      orig.pb(clean);
+      if(j > 0 && queries[i][j-1][1] != -1) clean = false;
+      if(clean) trie_node.pb(first[i]+j);
+    }
+  }
+  int N = ans.size();
+  runtime_assert((int)trie_node.size() == T.N);
+
+  if(opt.sat.stop && *opt.sat.stop) { ST.lap(&solve_stats::t_joint, "solve_joint"); return {}; }
+  sat_solver solver(opt.sat);
+  cnf_builder cnf(opt.amo, &solver);
+
+  int one = cnf.new_var();
+  cnf.clause({one});
+
+  // B[n][x]: node n is in base room x (0 when its label rules x out),
+  // C[n][a]: in copy a, A[n][x][a]: both
+  vector<vector<int>> B(N, vector<int>(size)), C(N, vector<int>(num_dups));
+  vector<vector<vector<int>>> A(N, vector<vector<int>>(size, vector<int>(num_dups)));
+  FOR(n, N) FOR(x, size) if(!orig[n] || base_tag[x] == ans[n]) B[n][x] = cnf.new_var();
+  FOR(n, N) FOR(a, num_dups) C[n][a] = cnf.new_var();
+  FOR(n, N) FOR(x, size) if(B[n][x]) FOR(a, num_dups) {
+    int v = A[n][x][a] = cnf.new_var();
+    cnf.clause({-v, B[n][x]});
+    cnf.clause({-v, C[n][a]});
+    cnf.clause({-B[n][x], -C[n][a], v});
+  }
+  // TB: doors between base rooms, TC: between their copies
+  vector<vector<array<int, 6>>> TB(size, vector<array<int, 6>>(size));
+  FOR(x, size) FOR(y, size) FOR(k, 6) TB[x][y][k] = cnf.new_var();
+  vector<vector<vector<array<int, 6>>>> TC(size);
+  FOR(x, size) TC[x].assign(num_dups, vector<array<int, 6>>(num_dups));
+  FOR(x, size) FOR(a, num_dups) FOR(b, num_dups) FOR(k, 6) TC[x][a][b][k] = cnf.new_var();
+
+  FOR(n, N) {
+    vector<int> row;
+    for(int v : B[n]) if(v) row.pb(v);
+    cnf.exactly_one(row);
+    cnf.exactly_one(C[n]);
+  }
+  FOR(x, size) cnf.clause({B[trie_node[clique[x]]][x]});
+  // every query starts in copy 0 of the same room
+  FOR(i, num_queries) {
+    cnf.clause({C[first[i]][0]});
+    if(i > 0) FOR(x, size) {
+      int u = B[first[0]][x], v = B[first[i]][x];
+      if(u && v) {
+        cnf.clause({-u, v});
+        cnf.clause({u, -v});
+      }else if(u || v) {
+        cnf.clause({-(u ? u : v)});
+      }
+    }
+  }
+
+  FOR(x, size) FOR(k, 6) {
+    vector<int> row(size);
+    FOR(y, size) row[y] = TB[x][y][k];
+    cnf.exactly_one(row);
+  }
+  // the edge (x -> y) comes with an edge (y -> x), as in solve_base
+  FOR(x, size) FOR(y, size) FOR(k, 6) {
+    cnf.add(-TB[x][y][k]);
+    FOR(k2, 6) cnf.add(TB[y][x][k2]);
+    cnf.add(0);
+  }
+  // door k is a bijection between the copies, as in solve_dup
+  FOR(x, size) FOR(k, 6) FOR(a, num_dups) {
+    vector<int> fwd(num_dups), bwd(num_dups);
+    FOR(b, num_dups) {
+      fwd[b] = TC[x][a][b][k];
+      bwd[b] = TC[x][b][a][k];
+    }
+    cnf.exactly_one(fwd);
+    cnf.exactly_one(bwd);
+  }
+  // and goes back between the same copies: RC[y][x][k2][b][a] is door k2
+  // from copy b of y to copy a of x
+  if(num_dups > 1) {
+    auto rc = [&](int y, int x, int k2, int b, int a) {
+      return (((y*size + x)*6 + k2)*num_dups + b)*num_dups + a;
+    };
+    vector<int> RC(size*size*6*num_dups*num_dups);
+    FOR(y, size) FOR(x, size) FOR(k2, 6) FOR(b, num_dups) FOR(a, num_dups) {
+      int v = RC[rc(y, x, k2, b, a)] = cnf.new_var();
+      cnf.clause({-v, TB[y][x][k2]});
+      cnf.clause({-v, TC[y][b][a][k2]});
+    }
+    FOR(x, size) FOR(y, size) FOR(k, 6) FOR(a, num_dups) FOR(b, num_dups) {
+      cnf.add(-TB[x][y][k]);
+      cnf.add(-TC[x][a][b][k]);
+      FOR(k2, 6) cnf.add(RC[rc(y, x, k2, b, a)]);
+      cnf.add(0);
+    }
+  }
+
+  // transitions along the walks
+  FOR(i, num_queries) FOR(j, queries[i].size()) {
+    int n = first[i]+j, m = n+1, k = queries[i][j][0];
+    FOR(x, size) if(B[n][x]) {
+      FOR(y, size) {
+        if(B[m][y]) cnf.clause({-B[n][x], -TB[x][y][k], B[m][y]});
+        else cnf.clause({-B[n][x], -TB[x][y][k]});
+      }
+      FOR(a, num_dups) FOR(b, num_dups) {
+        cnf.clause({-A[n][x][a], -TC[x][a][b][k], C[m][b]});
+      }
+    }
+  }
+
+  // labels: cur[x][a][c] is "copy a of x shows c" at the current step of
+  // the query, constant until the first write there
+  FOR(i, num_queries) {
+    vector<vector<array<int, 4>>> cur(size, vector<array<int, 4>>(num_dups));
+    FOR(x, size) FOR(a, num_dups) FOR(c, 4) cur[x][a][c] = c == base_tag[x] ? one : -one;
+    FOR(j, queries[i].size()+1) {
+      int n = first[i]+j;
+      FOR(x, size) FOR(a, num_dups) if(A[n][x][a]) {
+        int lit = cur[x][a][ans[n]];
+        if(lit == -one) cnf.clause({-A[n][x][a]});
+        else if(lit != one) cnf.clause({-A[n][x][a], lit});
+      }
+      if(j == 0 || queries[i][j-1][1] == -1) continue;
+      int w = queries[i][j-1][1];
+      FOR(x, size) FOR(a, num_dups) if(A[n][x][a]) {
+        int at = A[n][x][a];
+        array<int, 4> L;
+        FOR(c, 4) L[c] = cnf.new_var();
+        FOR(c, 4) {
+          cnf.clause({-at, c == w ? L[c] : -L[c]});
+          cnf.clause({at, -cur[x][a][c], L[c]});
+          cnf.clause({at, cur[x][a][c], -L[c]});
+        }
+        cur[x][a] = L;
+      }
+    }
+  }
+
+  if(opt.verbose) debug("solve_joint cnf", N, cnf.num_vars, cnf.num_clauses);
+  trace_counter("solve_joint cnf", {{"nodes", N}, {"vars", cnf.num_vars}, {"clauses", cnf.num_clauses}});
+  if(opt.stats) {
+    opt.stats->joint_vars = cnf.num_vars;
+    opt.stats->joint_clauses = cnf.num_clauses;
+  }
+
+  // the time slice is for the solve only
+  if(opt.sched) solver.config.deadline = opt.sched->slice(solve_stage::joint);
+  timer T_stage;
+  int res = solver.solve();
+  ST.lap(&solve_stats::t_joint, "solve_joint");
+  if(opt.sched) opt.sched->record(solve_stage::joint, T_stage.elapsed());
+  result(res);
+  if(res != 10) return {};
+
+  layout out_layout;
+  out_layout.size = size;
+  out_layout.num_dups = num_dups;
+  out_layout.tag.resize(size * num_dups);
+  out_layout.graph.resize(size * num_dups);
+  FOR(i, size*num_dups) out_layout.tag[i] = base_tag[i%size];
+  FOR(x, size) FOR(k, 6) FOR(y, size) if(solver.value(TB[x][y][k]) > 0) {
+    FOR(a, num_dups) FOR(b, num_dups) if(solver.value(TC[x][a][b][k]) > 0) {
+      out_layout.graph[x+a*size][k] = y+b*size;
+    }
+  }
+  FOR(x, size) if(B[0][x] && solver.value(B[0][x]) > 0) out_layout.start = x;
+  return out_layout;
+}
+
+layout solve_layout
+(queries_t const& Q, int size, int num_dups, int num_queries,
+ RNG& R, solve_options const& opt, layout* base)
+{
+  if(base) *base = {};
+  if(opt.strategy == solve_strategy::joint) {
+    auto L = solve_joint(Q, size, num_dups, num_queries, R, opt);
+    if(base && L.size != 0) *base = base_of(L);
+    return L;
+  }
+  auto B = solve_base(Q, size, num_dups, num_queries, R, opt);
+  if(base) *base = B;
+  if(B.size == 0) return {};
+  return solve_dup(Q, size, num_dups, num_queries, B, opt);
+}
+
+layout base_of(layout const& L) {
+  layout B;
+  B.size = L.size;
+  B.num_dups = 1;
+  B.tag.assign(L.tag.begin(), L.tag.begin() + L.size);
+  B.graph.resize(L.size);
+  FOR(x, L.size) FOR(k, 6) B.graph[x][k] = L.graph[x][k] % L.size;
+  B.start = L.start % L.size;
+  return B;
+}
+
+const char* uniqueness_name(uniqueness u) {
+  switch(u) {
+  case uniqueness::unique: return "unique";
+  case uniqueness::ambiguous: return "ambiguous";
+  case uniqueness::timeout: return "timeout";
+  }
+  return "?";
+}
+
+uniqueness check_unique
+(queries_t const& Q, int size, int num_dups, int num_queries,
+ layout const& base, layout const& found, RNG& R, solve_options opt,
+ layout* other)
+{
+  trace_scope scope("check_unique");
+  solve_stats stats;
+  opt.stats = &stats;
+  opt.sat.conflicts = opt.unique_conflicts;
+  int rounds = 0;
+
+  // a layout over B not equivalent to found: ambiguous, none (unique) or
+  // timeout
+  auto other_lift = [&](layout const& B, vector<layout> exclude) -> uniqueness {
+    solve_options o = opt;
+    o.exclude = &exclude;
+    while(1) {
+      if(rounds++ >= opt.unique_rounds) return uniqueness::timeout;
+      auto L = solve_dup(Q, size, num_dups, num_queries, B, o);
+      if(L.size == 0) return stats.dup_result == 20 ? uniqueness::unique : uniqueness::timeout;
+      if(auto m = verify_layout(L, Q)) {
+        debug("check_unique mismatch", m->query, m->step, m->expected, m->got);
+      }else if(!test_equivalence(L, found)) {
+        if(other) *other = L;
+        return uniqueness::ambiguous;
+      }
+      exclude.pb(L);
+    }
+  };
+
+  auto res = other_lift(base, { found });
+  if(res != uniqueness::unique) return res;
+
+  vector<layout> exclude = { base };
+  while(1) {
+    if(rounds++ >= opt.unique_rounds) return uniqueness::timeout;
+    solve_options o = opt;
+    o.exclude = &exclude;
+    auto B = solve_base(Q, size, num_dups, num_queries, R, o);
+    if(B.size == 0) return stats.base_result == 20 ? uniqueness::unique : uniqueness::timeout;
+    exclude.pb(B);
+    if(test_equivalence(B, base)) continue;
+    res = other_lift(B, {});
+    if(res != uniqueness::unique) return res;
+  }
+}
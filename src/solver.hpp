@@ -0,0 +1,141 @@
+#pragma once
+
+#include "layout.hpp"
+#include "queries.hpp"
+#include "options.hpp"
+#include "sat.hpp"
+#include "cnf.hpp"
+#include "replay.hpp"
+#include "designer.hpp"
+#include "scheduler.hpp"
+
+bool test_equivalence(layout const& a, layout const& b);
+
+struct layout_queries : QUERIES {
+  layout const& L;
+  layout_queries(layout const& L_) : L(L_) { }
+  // an engine per call: the replay state is not shared between threads
+  virtual vector<vector<int>> query(vector<vector<array<int,2>>> const& q) const override final {
+    replay_engine E(L);
+    return E.evaluate(0, q);
+  }
+};
+
+struct api_queries : QUERIES {
+  virtual vector<vector<int>> query(vector<vector<array<int,2>>> const& q) const override final;
+};
+
+// First answer a layout contradicts: answers[query][step], step 0 being
+// the starting room.
+struct answer_mismatch {
+  int query, step;
+  int expected, got;
+};
+
+// Replays every plan, charcoal writes included, on the candidates and
+// compares with the answers: nullopt for a candidate that matches them
+// all. The candidates are replayed together, W plans at a time.
+vector<optional<answer_mismatch>> verify_layouts(vector<layout> const& candidates, queries_t const& Q);
+optional<answer_mismatch> verify_layout(layout const& L, queries_t const& Q);
+
+// Per-stage wall times (seconds) and formula sizes, accumulated by the
+// solvers when solve_options::stats is set.
+struct solve_stats {
+  f64 t_trie = 0, t_clique = 0, t_quotient = 0, t_reduce = 0, t_cnf = 0, t_solve = 0;
+  f64 t_dup_cnf = 0, t_dup_solve = 0; // solve_dup up to the CNF, and its solve
+  f64 t_joint = 0;
+  i64 base_vars = 0, base_clauses = 0;
+  i64 dup_vars = 0, dup_clauses = 0;
+  i64 joint_vars = 0, joint_clauses = 0;
+  // last answer of each stage: 10 (found), 20 (none) or 0 (stopped, or out
+  // of conflicts)
+  int base_result = 0, dup_result = 0, joint_result = 0;
+};
+
+enum struct solve_strategy {
+  staged, // solve_base, then solve_dup
+  joint,  // solve_joint, experimental: far slower than staged at 30x3
+};
+
+solve_strategy parse_solve_strategy(string const& name);
+
+struct solve_options {
+  sat_config sat;
+  solve_strategy strategy = solve_strategy::staged;
+  // incremental with IPASIR only: with kissat reloaded at every round,
+  // 10-25x slower than the full encoding from 18 rooms on
+  bool lazy_transitions = false;
+  // fewer clauses from size 24 on, but no faster to solve up to 48 (see
+  // scripts/transition_report.sh), hence off by default
+  bool compact_transitions = false;
+  amo_encoding amo = amo_encoding::pairwise;
+  bool quotient = true;
+  bool domains = true;
+  bool verbose = false;
+  solve_stats* stats = nullptr;
+  scheduler* sched = nullptr; // time slices of the solves, if any
+  design_options design; // used by make_queries
+  // layouts the solution must differ from: base layouts for solve_base (up
+  // to the room labels), layouts over the given base for solve_dup (up to
+  // the copy labels, which are then in order of first visit)
+  vector<layout> const* exclude = nullptr;
+  bool unique = false;        // check_unique before guessing
+  int unique_rounds = 8;      // solves allowed to check_unique
+  i64 unique_conflicts = 1e6; // per solve in check_unique
+};
+
+// strategy, portfolio, seed, lazy, transitions, amo, quotient, domains,
+// verbose, design, design_samples, unique, unique_rounds, unique_conflicts
+solve_options parse_solve_options(options const& opts);
+// throws unless built with IPASIR and opt.sat has no portfolio, so that
+// the lazy rounds share one incremental solver
+void check_lazy_options(solve_options const& opt);
+// throws if opts sets lazy, transitions, quotient or domains, which
+// strategy=joint does not support
+void check_joint_options(options const& opts);
+
+queries_t make_queries
+(QUERIES const& Q, int size, int num_dups, int num_queries, f32 ratio_query1, RNG& R = rng,
+ design_options const& design = {});
+
+layout solve_base
+(queries_t const& Q, int size, int num_dups, int num_queries,
+ RNG& R = rng, solve_options const& opt = {});
+
+layout solve_dup
+(queries_t const& Q, int size, int num_dups, int num_queries, layout const& base_layout,
+ solve_options const& opt = {});
+
+// Rooms, copies and charcoal writes in a single formula over every
+// observation, not only the write-free prefixes: no base layout is fixed
+// before the copies are known. The rooms of the result are numbered as
+// solve_dup's (base room + copy * size). No quotient, domain reduction,
+// lazy or compact transitions, and no exclude.
+layout solve_joint
+(queries_t const& Q, int size, int num_dups, int num_queries,
+ RNG& R = rng, solve_options const& opt = {});
+
+// The layout by opt.strategy. base, if given, receives the base layout of
+// the result (solve_base's one when staged), or is left empty if there is
+// none.
+layout solve_layout
+(queries_t const& Q, int size, int num_dups, int num_queries,
+ RNG& R = rng, solve_options const& opt = {}, layout* base = nullptr);
+
+// The layout of the base rooms of L, rooms numbered as solve_dup's.
+layout base_of(layout const& L);
+
+enum struct uniqueness { unique, ambiguous, timeout };
+const char* uniqueness_name(uniqueness u);
+
+// Whether found (solve_dup's layout over base) is the only map matching
+// the observations, up to equivalence: solves again excluding it, first
+// over base and then over every other base layout. Solutions equivalent
+// to found, or contradicting the observations once replayed, are
+// excluded in turn. timeout when a solve runs out of conflicts or is
+// stopped, or after unique_rounds solves. When ambiguous, the other map is
+// written to other, if given.
+uniqueness check_unique
+(queries_t const& Q, int size, int num_dups, int num_queries,
+ layout const& base, layout const& found, RNG& R = rng, solve_options opt = {},
+ layout* other = nullptr);
@@ -0,0 +1,70 @@
+#include "trace.hpp"
+
+static FILE* trace_file = nullptr;
+static mutex trace_mutex;
+static timer trace_timer;
+
+static int trace_tid() {
+  static atomic<int> next_tid = 0;
+  thread_local int tid = next_tid++;
+  return tid;
+}
+
+void trace_open(string const& path) {
+  lock_guard<mutex> lock(trace_mutex);
+  runtime_assert(!trace_file);
+  trace_file = fopen(path.c_str(), "w");
+  runtime_assert(trace_file);
+  fprintf(trace_file, "[\n");
+  fflush(trace_file);
+  trace_timer.reset();
+}
+
+bool trace_enabled() {
+  return trace_file;
+}
+
+i64 trace_now() {
+  if(!trace_file) return 0;
+  return chrono::duration_cast<chrono::microseconds>
+    (chrono::high_resolution_clock::now() - trace_timer.t_begin).count();
+}
+
+void trace_complete(const char* name, i64 ts, i64 dur) {
+  if(!trace_file) return;
+  int tid = trace_tid();
+  lock_guard<mutex> lock(trace_mutex);
+  fprintf(trace_file,
+          "{\"name\":\"%s\",\"ph\":\"X\",\"ts\":%lld,\"dur\":%lld,\"pid\":0,\"tid\":%d},\n",
+          name, (long long)ts, (long long)dur, tid);
+  fflush(trace_file);
+}
+
+static void trace_phase(const char* name, char ph) {
+  if(!trace_file) return;
+  i64 ts = trace_now();
+  int tid = trace_tid();
+  lock_guard<mutex> lock(trace_mutex);
+  fprintf(trace_file, "{\"name\":\"%s\",\"ph\":\"%c\",\"ts\":%lld,\"pid\":0,\"tid\":%d},\n",
+          name, ph, (long long)ts, tid);
+  fflush(trace_file);
+}
+
+void trace_begin(const char* name) { trace_phase(name, 'B'); }
+void trace_end(const char* name) { trace_phase(name, 'E'); }
+
+void trace_counter(const char* name, vector<pair<string, f64>> const& values) {
+  if(!trace_file) return;
+  i64 ts = trace_now();
+  int tid = trace_tid();
+  string args;
+  for(auto const& [k, v] : values) {
+    if(!args.empty()) args += ",";
+    args += "\"" + k + "\":" + to_string(v);
+  }
+  lock_guard<mutex> lock(trace_mutex);
+  fprintf(trace_file,
+          "{\"name\":\"%s\",\"ph\":\"C\",\"ts\":%lld,\"pid\":0,\"tid\":%d,\"args\":{%s}},\n",
+          name, (long long)ts, tid, args.c_str());
+  fflush(trace_file);
+}
@@ -0,0 +1,31 @@
+#pragma once
+
+// Trace file in the Chrome trace format: "[" and then one event object per
+// line, each followed by a comma and the array left open, as allowed by
+// chrome://tracing and Perfetto. A line without its trailing comma is a
+// JSON object. Everything is a no-op until trace_open.
+
+void trace_open(string const& path);
+bool trace_enabled();
+
+// microseconds since trace_open
+i64 trace_now();
+
+// a finished span [ts, ts+dur)
+void trace_complete(const char* name, i64 ts, i64 dur);
+
+// open span on the calling thread, written as soon as it starts so that a
+// stalled run shows where it is stuck
+void trace_begin(const char* name);
+void trace_end(const char* name);
+
+// named values at the current time (plotted as counters)
+void trace_counter(const char* name, vector<pair<string, f64>> const& values);
+
+// span covering the lifetime of the object
+struct trace_scope {
+  const char* name;
+
+  trace_scope(const char* name_) : name(name_) { trace_begin(name); }
+  ~trace_scope() { trace_end(name); }
+};
@@ -0,0 +1,254 @@
+#include "trie.hpp"
+
+void obs_trie::build(vector<vector<array<int,2>>> const& queries,
+                     vector<vector<int>> const& answers) {
+  N = 0;
+  tag.clear(); to.clear(); parent.clear(); roots.clear();
+  FOR(i, queries.size()) {
+    roots.pb(N);
+    N += 1;
+    to.pb({-1,-1,-1,-1,-1,-1});
+    tag.pb(answers[i][0]);
+    parent.pb(-1);
+    FOR(j, queries[i].size()) {
+      if(queries[i][j][1] != -1) break;
+      to.back()[queries[i][j][0]] = N;
+      parent.pb(N-1);
+      N += 1;
+      to.pb({-1,-1,-1,-1,-1,-1});
+      tag.pb(answers[i][j+1]);
+    }
+  }
+}
+
+vector<int> max_clique(obs_trie const& T, RNG& R) {
+  vector<u64> h(T.N);
+  FOR(i, T.N) h[i] = R.randomInt64();
+
+  // Explicit-stack version of the recursion
+  //   clique(E) = concat over tags t of the largest of
+  //     { first node of E_t } and parent(clique(children of E_t via door j))
+  // where E_t are the nodes of E with tag t, in order. Node sets live in
+  // one arena; a frame owns [lo, hi) and its children are pushed above it.
+  struct frame {
+    int lo, hi;
+    u64 key;
+    int part[5];
+    int t, j;
+    vector<int> cur, res;
+  };
+
+  hash_map<u64, vector<int>> cache;
+  vector<int> arena(T.N), tmp;
+  iota(all(arena), 0);
+  vector<frame> stack;
+  vector<int> ret;
+
+  // resolves the set arena[lo, hi) into ret, or pushes a frame for it
+  auto open = [&](int lo, int hi) -> bool {
+    if(hi - lo <= 1) {
+      ret.assign(arena.begin()+lo, arena.begin()+hi);
+      return true;
+    }
+    u64 key = 0;
+    FORU(x, lo, hi-1) key ^= h[arena[x]];
+    auto it = cache.find(key);
+    if(it != cache.end()) {
+      ret = it->second;
+      return true;
+    }
+    frame f;
+    f.lo = lo; f.hi = hi; f.key = key;
+    tmp.clear();
+    FOR(t, 4) {
+      f.part[t] = lo + tmp.size();
+      FORU(x, lo, hi-1) if(T.tag[arena[x]] == t) tmp.pb(arena[x]);
+    }
+    f.part[4] = hi;
+    copy(all(tmp), arena.begin()+lo);
+    f.t = 0;
+    while(f.part[f.t] == f.part[f.t+1]) f.t += 1;
+    f.j = -1;
+    f.cur = {arena[f.part[f.t]]};
+    stack.pb(move(f));
+    return false;
+  };
+
+  // consumes ret as the clique of the current child set
+  auto consume = [&](frame& f) {
+    if(ret.size() > f.cur.size()) {
+      f.cur.clear();
+      for(int i : ret) f.cur.pb(T.parent[i]);
+    }
+    arena.resize(f.hi);
+  };
+
+  bool pending = false;
+  if(!open(0, T.N)) {
+    while(!stack.empty()) {
+      frame& f = stack.back();
+      if(pending) {
+        consume(f);
+        pending = false;
+      }
+      f.j += 1;
+      if(f.j == 6) {
+        f.res.insert(end(f.res), all(f.cur));
+        f.t += 1;
+        while(f.t < 4 && f.part[f.t] == f.part[f.t+1]) f.t += 1;
+        if(f.t == 4) {
+          ret = cache[f.key] = move(f.res);
+          stack.pop_back();
+          pending = true;
+          continue;
+        }
+        f.j = 0;
+        f.cur = {arena[f.part[f.t]]};
+      }
+      int sub_lo = arena.size();
+      FORU(x, f.part[f.t], f.part[f.t+1]-1) {
+        int c = T.to[arena[x]][f.j];
+        if(c != -1) arena.pb(c);
+      }
+      if(open(sub_lo, arena.size())) consume(stack.back());
+      else pending = false;
+    }
+  }
+  return ret;
+}
+
+// x and y cannot be the same room if some common door path leads to
+// different labels. find maps a node to its current representative.
+struct distinguisher {
+  hash_set<u64> seen;
+  vector<array<int, 2>> todo;
+
+  template<class F>
+  bool operator()(int x, int y, vector<int> const& tag,
+                  vector<array<int, 6>> const& to, F const& find) {
+    seen.clear();
+    todo.clear();
+    todo.pb({x, y});
+    while(!todo.empty()) {
+      auto [a, b] = todo.back(); todo.pop_back();
+      a = find(a); b = find(b);
+      if(a == b) continue;
+      if(tag[a] != tag[b]) return true;
+      if(seen.insert((u64)a << 32 | b).second) {
+        FOR(k, 6) if(to[a][k] != -1 && to[b][k] != -1) {
+          todo.pb({to[a][k], to[b][k]});
+        }
+      }
+    }
+    return false;
+  }
+};
+
+bool trie_quotient::build(obs_trie const& T, vector<int> const& anchors) {
+  vector<int> uf(T.N), ctag = T.tag;
+  vector<array<int, 6>> cto = T.to;
+  iota(all(uf), 0);
+  auto find = [&](int x) {
+    while(uf[x] != x) x = uf[x] = uf[uf[x]];
+    return x;
+  };
+
+  // congruence closure: merging two rooms merges their successors
+  vector<array<int, 2>> work;
+  auto merge = [&](int x, int y) -> bool {
+    work.clear();
+    work.pb({x, y});
+    while(!work.empty()) {
+      auto [a, b] = work.back(); work.pop_back();
+      a = find(a); b = find(b);
+      if(a == b) continue;
+      if(ctag[a] != ctag[b]) return false;
+      if(a > b) swap(a, b);
+      uf[b] = a;
+      FOR(k, 6) if(cto[b][k] != -1) {
+        if(cto[a][k] == -1) cto[a][k] = cto[b][k];
+        else work.pb({cto[a][k], cto[b][k]});
+      }
+    }
+    return true;
+  };
+
+  distinguisher dist;
+  auto distinguishable = [&](int x, int y) {
+    return dist(x, y, ctag, cto, find);
+  };
+
+  for(int r : T.roots) if(!merge(T.roots[0], r)) return false;
+
+  vector<char> is_anchor(T.N);
+  bool changed = true;
+  while(changed) {
+    changed = false;
+    for(int a : anchors) is_anchor[find(a)] = 1;
+    FOR(x, T.N) if(find(x) == x && !is_anchor[x]) {
+      int cnt = 0, last = -1;
+      for(int a : anchors) if(!distinguishable(x, a)) {
+        cnt += 1;
+        last = a;
+        if(cnt > 1) break;
+      }
+      if(cnt == 0) return false;
+      if(cnt == 1) {
+        if(!merge(x, last)) return false;
+        changed = true;
+      }
+    }
+  }
+
+  N = 0;
+  cls.assign(T.N, -1);
+  FOR(x, T.N) if(find(x) == x) cls[x] = N++;
+  FOR(x, T.N) cls[x] = cls[find(x)];
+  tag.assign(N, -1);
+  to.assign(N, {-1,-1,-1,-1,-1,-1});
+  FOR(x, T.N) if(find(x) == x) {
+    tag[cls[x]] = ctag[x];
+    FOR(k, 6) if(cto[x][k] != -1) to[cls[x]][k] = cls[cto[x][k]];
+  }
+  return true;
+}
+
+bool room_domains
+(int N, vector<int> const& tag, vector<array<int, 6>> const& to,
+ vector<int> const& anchors, int size, vector<room_set>& D)
+{
+  runtime_assert(size <= (int)room_set().size());
+  room_set all_rooms;
+  FOR(r, size) all_rooms[r] = 1;
+
+  distinguisher dist;
+  auto id = [](int x) { return x; };
+  D.assign(N, room_set());
+  FOR(x, N) FOR(r, size) if(!dist(x, anchors[r], tag, to, id)) D[x][r] = 1;
+  FOR(r, size) D[anchors[r]] = room_set().set(r);
+
+  // door k of room r leads to a room of next(r, k)
+  auto next = [&](int r, int k) -> room_set const& {
+    int y = to[anchors[r]][k];
+    return y == -1 ? all_rooms : D[y];
+  };
+
+  bool changed = true;
+  while(changed) {
+    changed = false;
+    FOR(x, N) FOR(k, 6) if(to[x][k] != -1) {
+      int y = to[x][k];
+      room_set fwd, bwd;
+      FOR(r, size) if(D[x][r]) {
+        room_set const& n = next(r, k);
+        fwd |= n;
+        if((n & D[y]).any()) bwd[r] = 1;
+      }
+      fwd &= D[y];
+      if(fwd != D[y]) { D[y] = fwd; changed = true; }
+      if(bwd != D[x]) { D[x] = bwd; changed = true; }
+      if(D[x].none() || D[y].none()) return false;
+    }
+  }
+  return true;
+}
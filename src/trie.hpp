@@ -0,0 +1,41 @@
+#pragma once
+
+// Write-free prefixes of the queries: one chain of nodes per query, node i
+// having observed label tag[i] and children to[i][door].
+struct obs_trie {
+  int N = 0;
+  vector<int> tag;
+  vector<array<int, 6>> to;
+  vector<int> parent;
+  vector<int> roots;
+
+  void build(vector<vector<array<int,2>>> const& queries,
+             vector<vector<int>> const& answers);
+};
+
+// Greedy set of pairwise distinguishable nodes, used to break the room
+// symmetry. Memoised on XOR hashes of the node sets.
+vector<int> max_clique(obs_trie const& T, RNG& R);
+
+// Quotient of the trie by the nodes that must be the same room: all roots
+// are the starting room, merged nodes have merged successors, and a node
+// distinguishable from every anchor but one is that anchor's room.
+struct trie_quotient {
+  int N = 0;
+  vector<int> tag;
+  vector<array<int, 6>> to;
+  vector<int> cls; // trie node -> class
+
+  // false if the observations are contradictory
+  bool build(obs_trie const& T, vector<int> const& anchors);
+};
+
+using room_set = bitset<96>;
+
+// Feasible rooms of every node: the rooms whose anchor is not
+// distinguishable from it, reduced to arc consistency along the edges
+// (a node's successor through door k must be a possible destination of
+// door k from one of the node's rooms). False if some domain is empty.
+bool room_domains
+(int N, vector<int> const& tag, vector<array<int, 6>> const& to,
+ vector<int> const& anchors, int size, vector<room_set>& D);